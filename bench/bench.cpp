@@ -0,0 +1,385 @@
+// Microbenchmarks for the simulation core. Run with
+//   ./toons_bench --benchmark_format=json --benchmark_out=bench.json
+// or build the bench_json target.
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <random>
+#include <vector>
+
+#include "batch.hpp"
+#include "board.hpp"
+#include "engine.hpp"
+#include "map.hpp"
+#include "options.hpp"
+#include "render.hpp"
+#include "replay.hpp"
+#include "rng.hpp"
+
+using namespace std;
+
+// Every operator new in the process is counted, so a benchmark can report how
+// many heap allocations its loop makes (the allocs counter, per iteration; the
+// framework itself adds a couple per run, which shows up as a few micro-allocs)
+static atomic<uint64_t> gAllocs{0};
+static void *counted_alloc(size_t n){
+    gAllocs.fetch_add(1, memory_order_relaxed);
+    if(void *p = malloc(n ? n : 1)) return p;
+    throw bad_alloc();
+}
+// Plain, array and sized forms alike, so every new and delete pairs malloc with free
+void *operator new(size_t n){ return counted_alloc(n); }
+void *operator new[](size_t n){ return counted_alloc(n); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+static void report_allocs(benchmark::State &state, uint64_t before){
+    state.counters["allocs"] = benchmark::Counter((double)(gAllocs.load() - before), benchmark::Counter::kAvgIterations);
+}
+
+static Options bench_options(int rows, int cols, int toons, unsigned seed = 1){
+    Options o;
+    o.rows = rows; o.cols = cols; o.toons = toons; o.seed = seed;
+    o.maxSteps = 1 << 30;
+    return o;
+}
+
+// Board sizes x toon counts shared by the per-tick and collision benchmarks
+static void board_args(benchmark::internal::Benchmark *b){
+    b->ArgNames({"rows", "cols", "toons"});
+    b->Args({18, 36, 3})->Args({200, 400, 3})->Args({200, 400, 1000})->Args({2000, 4000, 10000});
+}
+
+// One headless tick: timers, flag pre-pass and a turn for every toon. A race that
+// finishes is reset and set up again outside the timed region.
+template<RngKind K> static void BM_Tick(benchmark::State &state){
+    Options opt = bench_options((int)state.range(0), (int)state.range(1), (int)state.range(2));
+    opt.rng = K;
+    Board board(opt.rows, opt.cols, opt.toons);
+    setup_board(board, opt);
+    HeadlessRace race(opt, board);
+    const uint64_t allocs = gAllocs.load();
+    for(auto _ : state){
+        if(race.done()){
+            state.PauseTiming();
+            opt.seed++;
+            board.reset();
+            setup_board(board, opt);
+            race.reset();
+            state.ResumeTiming();
+        }
+        race.tick();
+    }
+    state.SetItemsProcessed(state.iterations() * opt.toons);   // toon turns
+    report_allocs(state, allocs);
+}
+BENCHMARK_TEMPLATE(BM_Tick, RngKind::MT)->Apply(board_args);
+BENCHMARK_TEMPLATE(BM_Tick, RngKind::XOSHIRO)->Apply(board_args);
+
+// The same tick under --sched tiles, on one lane or spread over several
+static void BM_TilesTick(benchmark::State &state){
+    Options opt = bench_options((int)state.range(0), (int)state.range(1), (int)state.range(2));
+    opt.sched = Sched::TILES;
+    Board board(opt.rows, opt.cols, opt.toons);
+    setup_board(board, opt);
+    HeadlessRace race(opt, board, nullptr, (int)state.range(3));
+    const uint64_t allocs = gAllocs.load();
+    for(auto _ : state){
+        if(race.done()){
+            state.PauseTiming();
+            opt.seed++;
+            board.reset();
+            setup_board(board, opt);
+            race.reset();
+            state.ResumeTiming();
+        }
+        race.tick();
+    }
+    state.SetItemsProcessed(state.iterations() * opt.toons);   // toon turns
+    report_allocs(state, allocs);
+}
+BENCHMARK(BM_TilesTick)->ArgNames({"rows", "cols", "toons", "lanes"})
+    ->Args({200, 400, 1000, 1})->Args({2000, 4000, 10000, 1})->Args({2000, 4000, 10000, 4})->UseRealTime();
+
+// Full repaint of the render buffer
+static void BM_RebuildGrid(benchmark::State &state){
+    Options opt = bench_options((int)state.range(0), (int)state.range(1), (int)state.range(2));
+    Board board(opt.rows, opt.cols, opt.toons);
+    setup_board(board, opt);
+    for(auto _ : state){
+        rebuild_grid(board);
+        benchmark::DoNotOptimize(board.scr.grid.data());
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)opt.rows * opt.cols);
+}
+BENCHMARK(BM_RebuildGrid)->Apply(board_args);
+
+// Stacked-mode frame text (borders, rows, steps line) without the write
+static void BM_BuildFrame(benchmark::State &state){
+    Options opt = bench_options((int)state.range(0), (int)state.range(1), (int)state.range(2));
+    Board board(opt.rows, opt.cols, opt.toons);
+    setup_board(board, opt);
+    rebuild_grid(board);
+    for(auto _ : state){
+        board.scr.frame.clear();
+        build_frame(board.scr, 1234);
+        benchmark::DoNotOptimize(board.scr.frame.data());
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)board.scr.frame.size());
+}
+BENCHMARK(BM_BuildFrame)->Apply(board_args);
+
+// A move with rendering on: occupancy update plus two patched cells
+static void BM_MoveToonPatched(benchmark::State &state){
+    Options opt = bench_options(200, 400, 3);
+    Board board(opt.rows, opt.cols, opt.toons);
+    setup_board(board, opt);
+    rebuild_grid(board);
+    mt19937 rng(7);
+    for(auto _ : state){
+        Pos s = pick_step(rng), cur = board.pos(0);
+        Pos nxt{cur.r + s.r, cur.c + s.c};
+        if(can_enter(board, 0, nxt)) move_toon(board, 0, nxt);
+        if(board.scr.dirty.size() > 4096) board.scr.dirty.clear();
+    }
+}
+BENCHMARK(BM_MoveToonPatched);
+
+// Collision check at random cells, including the sentinel ring
+static void BM_CanEnter(benchmark::State &state){
+    Options opt = bench_options((int)state.range(0), (int)state.range(1), (int)state.range(2));
+    Board board(opt.rows, opt.cols, opt.toons);
+    setup_board(board, opt);
+    mt19937 rng(3);
+    vector<Pos> probes(4096);
+    for(Pos &p : probes) p = {(int)(rng() % (opt.rows + 2)) - 1, (int)(rng() % (opt.cols + 2)) - 1};
+    size_t i = 0; int ok = 0;
+    for(auto _ : state){
+        ok += can_enter(board, 0, probes[i]);
+        i = (i + 1) & (probes.size() - 1);
+    }
+    benchmark::DoNotOptimize(ok);
+}
+BENCHMARK(BM_CanEnter)->Apply(board_args);
+
+// Random draws: both --rng backends through the movement helpers
+template<class Rng> static void BM_PickStep(benchmark::State &state){
+    Rng rng = toon_streams<Rng>(5, 1)[0];
+    for(auto _ : state) benchmark::DoNotOptimize(pick_step(rng));
+}
+BENCHMARK_TEMPLATE(BM_PickStep, mt19937);
+BENCHMARK_TEMPLATE(BM_PickStep, FastRng);
+
+template<class Rng> static void BM_ChooseStep(benchmark::State &state){
+    Rng rng = toon_streams<Rng>(5, 1)[0];
+    for(auto _ : state) benchmark::DoNotOptimize(choose_step({1, 1}, rng));
+}
+BENCHMARK_TEMPLATE(BM_ChooseStep, mt19937);
+BENCHMARK_TEMPLATE(BM_ChooseStep, FastRng);
+
+// Seeding every toon's stream, as each race does once
+template<class Rng> static void BM_ToonStreams(benchmark::State &state){
+    for(auto _ : state) benchmark::DoNotOptimize(toon_streams<Rng>(5, (int)state.range(0)).data());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_ToonStreams, mt19937)->ArgName("toons")->Arg(3)->Arg(10000);
+BENCHMARK_TEMPLATE(BM_ToonStreams, FastRng)->ArgName("toons")->Arg(3)->Arg(10000);
+
+// YosemiteSam targeting: linear scan for small crowds, ring search above RING_SEARCH_MIN
+static void BM_NearestTarget(benchmark::State &state){
+    const int n = (int)state.range(0);
+    Options opt = bench_options(200, 400, n);
+    Board board(opt.rows, opt.cols, opt.toons);
+    setup_board(board, opt);
+    int t = 0;
+    for(auto _ : state){
+        benchmark::DoNotOptimize(nearest_target(board, t));
+        if(++t == n) t = 0;
+    }
+}
+BENCHMARK(BM_NearestTarget)->ArgName("toons")->Arg(3)->Arg(100)->Arg(10000);
+
+// Walk every static cell of a large board through the accessor API
+static void BM_FlatGridScan(benchmark::State &state){
+    Board board((int)state.range(0), (int)state.range(1), 3);
+    for(auto _ : state){
+        long open = 0;
+        for(int r=0;r<board.R;r++) for(int c=0;c<board.C;c++) open += Board::walkable(board.at(r,c));
+        benchmark::DoNotOptimize(open);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)board.R * board.C);
+}
+BENCHMARK(BM_FlatGridScan)->Args({2000, 4000});
+
+// The same cells packed into the open bitboard (AVX2/NEON when compiled in), as
+// every setup, map load and reset does once
+static void BM_PackOpen(benchmark::State &state){
+    Board board((int)state.range(0), (int)state.range(1), 3);
+    for(auto _ : state){
+        board.pack_open();
+        benchmark::DoNotOptimize(board.open);
+    }
+    state.SetBytesProcessed(state.iterations() * (int64_t)board.layer->cell.size());
+    state.SetLabel(bitboard_isa());
+}
+BENCHMARK(BM_PackOpen)->Args({200, 400})->Args({2000, 4000});
+
+// Open-cell count for --stats: a popcount over the bitboard
+static void BM_Density(benchmark::State &state){
+    Board board((int)state.range(0), (int)state.range(1), 3);
+    for(auto _ : state) benchmark::DoNotOptimize(board_density(board).open);
+    state.SetBytesProcessed(state.iterations() * (int64_t)board.layer->open.size() * 8);
+    state.SetLabel(bitboard_isa());
+}
+BENCHMARK(BM_Density)->Args({200, 400})->Args({2000, 4000});
+
+// --policy field: one BFS over the board, as every race with that policy pays it
+static void BM_DistanceField(benchmark::State &state){
+    Options opt = bench_options((int)state.range(0), (int)state.range(1), (int)state.range(2));
+    Board board(opt.rows, opt.cols, opt.toons);
+    setup_board(board, opt);
+    for(auto _ : state){
+        build_distance_field(board);
+        benchmark::DoNotOptimize(board.dist);
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)opt.rows * opt.cols);   // cells
+}
+BENCHMARK(BM_DistanceField)->Apply(board_args);
+
+// --branches: rewinding a worker's fork to the snapshot and reseeding it, against
+// building and setting up a fresh board for the same continuation
+static void BM_ForkRestore(benchmark::State &state){
+    Options opt = bench_options((int)state.range(0), (int)state.range(1), (int)state.range(2));
+    opt.rng = RngKind::XOSHIRO;
+    Board board(opt.rows, opt.cols, opt.toons);
+    setup_board(board, opt);
+    HeadlessRace trunk(opt, board);
+    for(int i=0;i<10 && !trunk.done();i++) trunk.tick();
+    const RaceSnapshot snap = trunk.snapshot();
+    Board fork(board);
+    HeadlessRace race(opt, fork);
+    uint32_t k = 0;
+    for(auto _ : state){
+        race.restore(snap);
+        race.reseed(race_seed(opt.seed, k++));
+        benchmark::DoNotOptimize(fork.tr.data());
+    }
+}
+BENCHMARK(BM_ForkRestore)->Apply(board_args);
+
+static void BM_FreshBoard(benchmark::State &state){
+    Options opt = bench_options((int)state.range(0), (int)state.range(1), (int)state.range(2));
+    opt.rng = RngKind::XOSHIRO;
+    for(auto _ : state){
+        Board board(opt.rows, opt.cols, opt.toons);
+        setup_board(board, opt);
+        HeadlessRace race(opt, board);
+        benchmark::DoNotOptimize(board.tr.data());
+    }
+}
+BENCHMARK(BM_FreshBoard)->Apply(board_args);
+
+// What a warm worker pays to start a race: set the board up from the seed, or
+// load a set-up layout (the server's layout cache), then rewind the race
+static void BM_RaceStart(benchmark::State &state){
+    Options opt = bench_options((int)state.range(0), (int)state.range(1), (int)state.range(2));
+    opt.policy = state.range(3) ? Policy::FIELD : Policy::GREEDY;
+    Board board(opt.rows, opt.cols, opt.toons);
+    setup_board(board, opt);
+    const Layout layout = board.layout();
+    HeadlessRace race(opt, board);
+    const bool cached = state.range(4);
+    const uint64_t allocs = gAllocs.load();
+    for(auto _ : state){
+        if(cached) board.load(layout);
+        else { board.reset(); setup_board(board, opt); }
+        race.reset();
+        benchmark::DoNotOptimize(board.tr.data());
+    }
+    report_allocs(state, allocs);
+}
+BENCHMARK(BM_RaceStart)->ArgNames({"rows", "cols", "toons", "field", "cached"})
+    ->ArgsProduct({{18}, {36}, {3}, {0, 1}, {0, 1}})->Args({200, 400, 300, 1, 0})->Args({200, 400, 300, 1, 1});
+
+// --map: mmap, check and copy a generated board into a Board, as text or binary
+static void BM_MapLoad(benchmark::State &state){
+    Options opt = bench_options((int)state.range(0), (int)state.range(1), 3);
+    const bool binary = state.range(2);
+    Board src(opt.rows, opt.cols, opt.toons);
+    setup_board(src, opt);
+    const string path = binary ? "toons_bench_map.bin" : "toons_bench_map.txt";
+    if(binary) save_map(src, path);
+    else {
+        for(int t=0;t<src.n;t++) src.edit(src.tr[t], src.tc[t]) = 'S';
+        FILE *f = fopen(path.c_str(), "wb");
+        for(int r=0;r<src.R;r++){ fwrite(src.row(r), 1, src.C, f); fputc('\n', f); }
+        fclose(f);
+    }
+    Board board(opt.rows, opt.cols, opt.toons);
+    for(auto _ : state){
+        MapFile map(path, opt.toons);
+        map.load(board, opt);
+        benchmark::DoNotOptimize(board.cell);
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)opt.rows * opt.cols);   // cells
+    remove(path.c_str());
+}
+BENCHMARK(BM_MapLoad)->ArgNames({"rows", "cols", "binary"})
+    ->Args({200, 400, 0})->Args({200, 400, 1})->Args({2000, 4000, 0})->Args({2000, 4000, 1});
+
+// End to end: board setup plus a whole headless race, as a warm --races worker
+// runs them (one board and one race, reset every time)
+static void BM_Races(benchmark::State &state){
+    Options opt = bench_options((int)state.range(0), (int)state.range(1), (int)state.range(2));
+    opt.maxSteps = 10000;
+    opt.policy = state.range(3) ? Policy::FIELD : Policy::GREEDY;
+    opt.rng = state.range(4) ? RngKind::XOSHIRO : RngKind::MT;
+    opt.sched = state.range(5) ? Sched::EVENT : Sched::TICK;
+    Options ro = opt;
+    Board board(ro.rows, ro.cols, ro.toons);
+    setup_board(board, ro);
+    HeadlessRace race(ro, board);
+    while(!race.done()) race.tick();                            // warm-up race
+    uint32_t i = 0;
+    const uint64_t allocs = gAllocs.load();
+    for(auto _ : state){
+        ro.seed = race_seed(opt.seed, i++);
+        board.reset();
+        setup_board(board, ro);
+        race.reset();
+        while(!race.done()) race.tick();
+        benchmark::DoNotOptimize(race.result().winner);
+    }
+    state.SetItemsProcessed(state.iterations());                // races
+    report_allocs(state, allocs);
+}
+BENCHMARK(BM_Races)->ArgNames({"rows", "cols", "toons", "field", "xoshiro", "event"})
+    ->Args({18, 36, 3, 0, 0, 0})->Args({18, 36, 3, 1, 0, 0})->Args({18, 36, 3, 0, 1, 0})->Args({18, 36, 3, 0, 0, 1})
+    ->Args({200, 400, 3, 0, 0, 0})->Args({200, 400, 3, 1, 0, 0})->Args({200, 400, 3, 0, 1, 0})->Args({200, 400, 3, 0, 0, 1})
+    ->Args({200, 400, 300, 0, 0, 0})->Args({200, 400, 300, 1, 0, 0})->Args({200, 400, 300, 0, 1, 0})->Args({200, 400, 300, 0, 0, 1});
+
+// Same race with every move, freeze and win going through the replay writer
+static void BM_RacesRecorded(benchmark::State &state){
+    Options opt = bench_options(200, 400, (int)state.range(0));
+    opt.maxSteps = 10000;
+    uint32_t i = 0;
+    for(auto _ : state){
+        Options ro = opt;
+        ro.seed = race_seed(opt.seed, i++);
+        Board board(ro.rows, ro.cols, ro.toons);
+        setup_board(board, ro);
+        ReplayWriter log("/dev/null", board, ro.seed, false);
+        benchmark::DoNotOptimize(run_headless(ro, board, state.range(1) ? &log : nullptr).winner);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RacesRecorded)->ArgNames({"toons", "record"})->ArgsProduct({{3, 300}, {0, 1}});
+
+BENCHMARK_MAIN();
@@ -0,0 +1,156 @@
+// toons_agg: summarises --results files. Usage:
+//   toons_agg [--jobs N] FILE...
+// Races are grouped by options hash and toon count; each group prints its win
+// rates with 95% Wilson intervals, step percentiles per archetype, tick
+// percentiles and mean event counts. Blocks are shared out over the workers,
+// each folding into its own tallies, merged once at the end.
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "batch.hpp"
+#include "board.hpp"
+#include "mapped_file.hpp"
+#include "results.hpp"
+
+using namespace std;
+
+// Exact counts per value: dense up to DENSE, then a sparse map, so a huge or
+// corrupt value costs one map entry rather than a vector sized to it
+struct Hist {
+    static constexpr uint32_t DENSE = 1u << 16;
+    vector<uint64_t> n;
+    map<uint32_t, uint64_t> big;
+    uint64_t total = 0;
+    void add(uint32_t v){
+        if(v >= DENSE) big[v]++;
+        else { if(v >= n.size()) n.resize((size_t)v + 1, 0); n[v]++; }
+        total++;
+    }
+    void merge(const Hist &o){
+        if(o.n.size() > n.size()) n.resize(o.n.size(), 0);
+        for(size_t v=0;v<o.n.size();v++) n[v] += o.n[v];
+        for(auto &kv : o.big) big[kv.first] += kv.second;
+        total += o.total;
+    }
+    // Smallest value with at least q of the entries at or below it
+    uint64_t pct(double q) const {
+        const uint64_t want = max<uint64_t>(1, (uint64_t)ceil(q * (double)total));
+        uint64_t seen = 0;
+        for(size_t v=0;v<n.size();v++) if((seen += n[v]) >= want) return v;
+        for(auto &kv : big) if((seen += kv.second) >= want) return kv.first;
+        return !big.empty() ? big.rbegin()->first : n.empty() ? 0 : n.size() - 1;
+    }
+};
+
+struct Group {
+    size_t first = SIZE_MAX;                       // lowest block index, for output order
+    uint32_t toons = 0;
+    uint64_t races = 0, noWinner = 0;
+    uint64_t wins[NKINDS] = {};
+    uint64_t counts[NRESULTCOUNTS] = {};
+    Hist ticks, steps[NKINDS];
+
+    void add(const ResultsBlock &b, uint32_t i){
+        races++;
+        const int32_t w = b.winner(i);
+        if(w >= 0) wins[w % NKINDS]++; else noWinner++;
+        for(int c=0;c<NRESULTCOUNTS;c++) counts[c] += b.count((ResultCount)c, i);
+        ticks.add(b.count(R_TICKS, i));
+        for(uint32_t t=0;t<b.toons;t++) steps[t % NKINDS].add(b.steps(t, i));
+    }
+    void merge(const Group &o){
+        first = min(first, o.first); toons = o.toons;
+        races += o.races; noWinner += o.noWinner;
+        for(int k=0;k<NKINDS;k++){ wins[k] += o.wins[k]; steps[k].merge(o.steps[k]); }
+        for(int c=0;c<NRESULTCOUNTS;c++) counts[c] += o.counts[c];
+        ticks.merge(o.ticks);
+    }
+};
+
+using Key = pair<uint64_t, uint32_t>;             // (options hash, toons)
+
+// 95% Wilson score interval for k successes out of n, in percent
+static pair<double,double> wilson(uint64_t k, uint64_t n){
+    const double z = 1.96, nn = (double)n, p = k / nn;
+    const double d = 1 + z*z/nn, mid = (p + z*z/(2*nn)) / d;
+    const double half = z * sqrt(p*(1-p)/nn + z*z/(4*nn*nn)) / d;
+    return {100*max(0.0, mid - half), 100*min(1.0, mid + half)};
+}
+
+static void print_group(const Key &key, const Group &g){
+    cout << "setup " << hex << setw(16) << setfill('0') << key.first << dec << setfill(' ')
+         << "  toons: " << g.toons << "  races: " << g.races << "\n";
+    const double races = (double)max<uint64_t>(1, g.races);
+    const int kinds = (int)min<uint32_t>(g.toons, NKINDS);
+    for(int k=0;k<kinds;k++){
+        const pair<double,double> ci = wilson(g.wins[k], max<uint64_t>(1, g.races));
+        cout << "  " << TOON_NM[k] << " (" << TOON_CH[k] << ") wins: " << g.wins[k] << " (" << fixed << setprecision(2)
+             << 100.0*g.wins[k]/races << "%, 95% CI " << ci.first << "-" << ci.second << "%)  steps p50/p90/p99: "
+             << g.steps[k].pct(0.5) << "/" << g.steps[k].pct(0.9) << "/" << g.steps[k].pct(0.99) << "\n";
+    }
+    cout << "  No winner: " << g.noWinner << "  ticks p50/p90/p99: "
+         << g.ticks.pct(0.5) << "/" << g.ticks.pct(0.9) << "/" << g.ticks.pct(0.99) << "\n";
+    cout << "  per race: steps " << g.counts[R_STEPS]/races << "  jumps " << g.counts[R_JUMPS]/races
+         << "  bursts " << g.counts[R_BURSTS]/races << "  shots " << g.counts[R_SHOTS]/races
+         << "  freezes " << g.counts[R_FREEZES]/races << "\n";
+}
+
+int main(int argc, char** argv){
+    int jobs = (int)max(1u, thread::hardware_concurrency());
+    vector<string> paths;
+    for(int i=1;i<argc;i++){
+        const string a = argv[i];
+        if(a=="--jobs" && i+1<argc) jobs = max(1, atoi(argv[++i]));
+        else if(a=="--help"){ cout << "Usage: toons_agg [--jobs N] FILE...\n"; return 0; }
+        else paths.push_back(a);
+    }
+    if(paths.empty()){ cerr << "Usage: toons_agg [--jobs N] FILE...\n"; return 1; }
+
+    vector<unique_ptr<MappedFile>> files;
+    vector<ResultsBlock> blocks;
+    for(const string &p : paths){
+        files.push_back(make_unique<MappedFile>(p));
+        string err;
+        if(!files.back()->data()){ cerr << "toons_agg: cannot read " << p << "\n"; return 1; }
+        if(!results_blocks(files.back()->data(), files.back()->size(), blocks, err)){ cerr << "toons_agg: " << p << ": " << err << "\n"; return 1; }
+    }
+
+    jobs = min(jobs, max(1, (int)blocks.size()));
+    vector<map<Key, Group>> parts(jobs);
+    const double secs = run_pool(jobs, (uint32_t)blocks.size(), [&](int w, uint32_t k){
+        const ResultsBlock &b = blocks[k];
+        Group *g = nullptr;
+        uint64_t last = 0;
+        for(uint32_t i=0;i<b.races;i++){
+            const uint64_t h = b.hash(i);
+            if(!g || h != last){                       // a block mostly holds one setup
+                g = &parts[w][{h, b.toons}]; last = h;
+                g->first = min(g->first, (size_t)k); g->toons = b.toons;
+            }
+            g->add(b, i);
+        }
+    });
+    map<Key, Group> all;
+    for(auto &part : parts) for(auto &kv : part) all[kv.first].merge(kv.second);
+
+    vector<pair<Key, const Group*>> order;
+    uint64_t races = 0;
+    for(auto &kv : all){ order.push_back({kv.first, &kv.second}); races += kv.second.races; }
+    sort(order.begin(), order.end(), [](auto &a, auto &b){ return a.second->first < b.second->first; });
+
+    cout << "=== Results ===\n";
+    cout << "files: " << paths.size() << "  blocks: " << blocks.size() << "  races: " << races
+         << "  setups: " << order.size() << "  (" << fixed << setprecision(2) << secs << " s)\n";
+    for(auto &kv : order) print_group(kv.first, *kv.second);
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include "batch.hpp"
+
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "map.hpp"
+#include "results.hpp"
+
+using namespace std;
+
+void print_batch(const Options &opt, const BatchTally &tot, double secs){
+    const int n = (int)tot.wins.size();
+    const double races = (double)max<uint64_t>(1, tot.races);
+    auto perKind = [&](int k){ return (double)((opt.toons - k + NKINDS-1) / NKINDS); };   // toons of archetype k
+    cout << "=== Batch Summary ===\n";
+    cout << "races: " << tot.races << "  jobs: " << opt.jobs << "  seed: " << opt.seed
+         << "  (" << fixed << setprecision(0) << tot.races / max(secs, 1e-9) << " races/s)\n";
+    cout << setprecision(2);
+    for(int t=0;t<n;t++)
+        cout << TOON_NM[t] << " (" << TOON_CH[t] << ") wins: " << tot.wins[t]
+             << " (" << 100.0*tot.wins[t]/races << "%)  mean steps: " << tot.stepSum[t]/(races*perKind(t)) << "\n";
+    cout << "No winner: " << tot.noWinner << "  mean ticks: " << tot.ticks/races << "\n";
+
+    int last = 0;
+    for(int t=0;t<n;t++) for(int k=0;k<STEP_BUCKETS;k++) if(tot.stepHist[t][k]) last = max(last, k);
+    cout << (opt.toons > NKINDS ? "Steps histogram (toon-races per bucket)\n" : "Steps histogram (races per bucket)\n") << setw(12) << "steps";
+    for(int t=0;t<n;t++) cout << setw(12) << TOON_NM[t];
+    cout << "\n";
+    for(int k=0;k<=last;k++){
+        string label = k==0 ? "0" : k==1 ? "1" : to_string(1<<(k-1)) + "-" + to_string((1<<k)-1);
+        if(k==STEP_BUCKETS-1) label = to_string(1<<(k-1)) + "+";
+        cout << setw(12) << label;
+        for(int t=0;t<n;t++) cout << setw(12) << tot.stepHist[t][k];
+        cout << "\n";
+    }
+}
+
+int run_batch(const Options &opt, const MapFile *map, ResultsFile *results){
+    const int jobs = min(opt.jobs, max(1, opt.races));
+    const uint64_t hash = options_hash(opt);
+    vector<BatchTally> tallies(jobs, BatchTally(opt.toons));
+    vector<unique_ptr<ResultsBuffer>> rows(jobs);
+    vector<Options> ros(jobs, opt);                  // per worker; only the seed changes
+    // One board and one race per worker, reset for every race, so a warm worker
+    // runs its races without touching the heap
+    vector<unique_ptr<Board>> boards(jobs);
+    vector<unique_ptr<HeadlessRace>> races(jobs);
+    double secs = run_pool(jobs, (uint32_t)opt.races, [&](int w, uint32_t i){
+        Options &ro = ros[w];
+        ro.seed = race_seed(opt.seed, i);
+        if(!boards[w]) boards[w] = make_unique<Board>(ro.rows, ro.cols, ro.toons);
+        else boards[w]->reset();
+        Board &board = *boards[w];
+        if(map) map->load(board, ro); else setup_board(board, ro);
+        if(!races[w]) races[w] = make_unique<HeadlessRace>(ro, board);
+        else races[w]->reset();
+        HeadlessRace &race = *races[w];
+        while(!race.done()) race.tick();
+        tallies[w].add(board, race.result());
+        if(!rows[w]) rows[w] = make_unique<ResultsBuffer>(results);
+        rows[w]->add(ro.seed, hash, board, race.result());
+    });
+    rows.clear();                                    // flushes each worker's last block
+
+    BatchTally tot(opt.toons);
+    for(auto &t : tallies) tot.merge(t);
+    print_batch(opt, tot, secs);
+    return 0;
+}
+
+int run_branches(const Options &opt, Board &board, ResultsFile *results){
+    HeadlessRace trunk(opt, board);
+    while(!trunk.done() && trunk.result().ticks < opt.forkAt) trunk.tick();
+    const RaceSnapshot snap = trunk.snapshot();
+
+    // One fork and one race per worker, rewound to the snapshot for every branch
+    const int jobs = min(opt.jobs, max(1, opt.branches));
+    const uint64_t hash = options_hash(opt);
+    vector<BatchTally> tallies(jobs, BatchTally(opt.toons));
+    vector<unique_ptr<ResultsBuffer>> rows(jobs);
+    vector<unique_ptr<Board>> forks(jobs);
+    vector<unique_ptr<HeadlessRace>> races(jobs);
+    double secs = run_pool(jobs, (uint32_t)opt.branches, [&](int w, uint32_t k){
+        if(!races[w]){
+            forks[w] = make_unique<Board>(board); races[w] = make_unique<HeadlessRace>(opt, *forks[w]);
+            rows[w] = make_unique<ResultsBuffer>(results);
+        }
+        HeadlessRace &race = *races[w];
+        const unsigned seed = race_seed(opt.seed, k);
+        race.restore(snap);
+        race.reseed(seed);
+        while(!race.done()) race.tick();
+        tallies[w].add(*forks[w], race.result());
+        rows[w]->add(seed, hash, *forks[w], race.result());
+    });
+    rows.clear();
+
+    BatchTally tot(opt.toons);
+    for(auto &t : tallies) tot.merge(t);
+    cout << "Forked at tick " << snap.res.ticks << " (" << snap.res.totalSteps << " steps"
+         << (snap.res.winner >= 0 ? ", already won by " + toon_name(board, snap.res.winner) : string()) << ")\n";
+    print_batch(opt, tot, secs);
+    return 0;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "board.hpp"
+#include "engine.hpp"
+#include "options.hpp"
+
+// ---- Batch Monte Carlo ----
+
+// Race i of a batch gets its own seed, mixed from the batch seed (splitmix64)
+inline unsigned race_seed(unsigned base, uint32_t i){
+    uint64_t z = ((uint64_t)base << 32 | i) + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return (unsigned)(z ^ (z >> 31));
+}
+
+// Contiguous run of race indices owned by one worker. The owner pops from the
+// front, idle workers steal the back half; both sides CAS the same word, so
+// there is no lock anywhere. Indices only ever move between spans, never repeat.
+struct alignas(64) StealRange {
+    std::atomic<uint64_t> span{0};                 // lo << 32 | hi
+    static uint64_t pack(uint32_t lo, uint32_t hi){ return (uint64_t)lo << 32 | hi; }
+
+    void reset(uint32_t lo, uint32_t hi){ span.store(pack(lo,hi), std::memory_order_release); }
+    bool pop(uint32_t &i){
+        uint64_t s = span.load(std::memory_order_acquire);
+        for(;;){
+            uint32_t lo = s>>32, hi = (uint32_t)s;
+            if(lo >= hi) return false;
+            if(span.compare_exchange_weak(s, pack(lo+1,hi), std::memory_order_acq_rel)){ i = lo; return true; }
+        }
+    }
+    bool steal(uint32_t &lo_out, uint32_t &hi_out){
+        uint64_t s = span.load(std::memory_order_acquire);
+        for(;;){
+            uint32_t lo = s>>32, hi = (uint32_t)s;
+            if(lo >= hi) return false;
+            uint32_t mid = lo + (hi-lo)/2;
+            if(span.compare_exchange_weak(s, pack(lo,mid), std::memory_order_acq_rel)){ lo_out = mid; hi_out = hi; return true; }
+        }
+    }
+};
+
+// Runs race(w, i) for every i < total on jobs workers. Each starts on an even
+// share and, once it runs dry, steals the back half of another worker's rest.
+// Returns the wall-clock seconds taken.
+template<class Race> double run_pool(int jobs, uint32_t total, Race &&race){
+    std::vector<StealRange> ranges(jobs);
+    for(int w=0;w<jobs;w++) ranges[w].reset((uint32_t)((uint64_t)total*w/jobs), (uint32_t)((uint64_t)total*(w+1)/jobs));
+
+    auto work = [&](int w){
+        for(;;){
+            uint32_t i;
+            if(!ranges[w].pop(i)){
+                bool stole = false;
+                for(int k=1;k<jobs && !stole;k++){
+                    uint32_t lo, hi;
+                    if(ranges[(w+k)%jobs].steal(lo,hi)){ ranges[w].reset(lo,hi); stole = true; }
+                }
+                if(!stole || gStop.load()) return;
+                continue;
+            }
+            race(w, i);
+        }
+    };
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool; pool.reserve(jobs);
+    for(int w=0;w<jobs;w++) pool.emplace_back(work, w);
+    for(auto &th : pool) th.join();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+constexpr int STEP_BUCKETS = 16;            // log2 buckets: 0, 1, 2-3, 4-7, ...
+inline int step_bucket(int steps){
+    int b = 0; while(steps > 0 && b < STEP_BUCKETS-1){ steps >>= 1; b++; }
+    return b;
+}
+
+// Per-worker tallies, padded so workers never share a cache line. Columns are
+// archetypes, which for the default three toons is the same as per toon.
+struct alignas(64) BatchTally {
+    std::vector<uint64_t> wins;                    // per archetype
+    std::vector<uint64_t> stepSum;                 // per archetype, summed over its toons
+    std::vector<std::array<uint64_t,STEP_BUCKETS>> stepHist; // per archetype, one entry per toon and race
+    uint64_t noWinner = 0, races = 0, ticks = 0;
+
+    explicit BatchTally(int n) : wins(std::min(n,NKINDS),0), stepSum(wins.size(),0), stepHist(wins.size()) {
+        for(auto &h : stepHist) h.fill(0);
+    }
+    void add(const Board &b, const RaceResult &res){
+        races++; ticks += res.ticks;
+        if(res.winner >= 0) wins[b.kind[res.winner]]++; else noWinner++;
+        for(int t=0;t<b.n;t++){
+            stepSum[b.kind[t]] += b.steps[t];
+            stepHist[b.kind[t]][step_bucket((int)b.steps[t])]++;
+        }
+    }
+    void merge(const BatchTally &o){
+        races += o.races; ticks += o.ticks; noWinner += o.noWinner;
+        for(size_t t=0;t<wins.size();t++){
+            wins[t] += o.wins[t]; stepSum[t] += o.stepSum[t];
+            for(int k=0;k<STEP_BUCKETS;k++) stepHist[t][k] += o.stepHist[t][k];
+        }
+    }
+};
+
+void print_batch(const Options &opt, const BatchTally &tot, double secs);
+
+class MapFile;
+class ResultsFile;
+
+// Shards race indices over opt.jobs workers. Each race sets up a board from
+// race_seed(opt.seed, i) (or loads map, if given) and runs headless; workers reuse
+// one board and one race throughout and only touch their own tally (and their
+// own results buffer, if results is given).
+int run_batch(const Options &opt, const MapFile *map = nullptr, ResultsFile *results = nullptr);
+
+// --branches N: runs the race on board to tick opt.forkAt, snapshots it, then
+// finishes it N times over opt.jobs workers, branch k on fresh streams from
+// race_seed(opt.seed, k). Each worker forks board once and rewinds that fork
+// per branch, so the static layer is shared and never reallocated.
+int run_branches(const Options &opt, Board &board, ResultsFile *results = nullptr);
@@ -0,0 +1,149 @@
+#include "bitboard.hpp"
+
+#include <cstring>
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+using namespace std;
+
+static inline uint64_t popcount64(uint64_t v){
+#if defined(_MSC_VER)
+    return (uint64_t)__popcnt64(v);
+#else
+    return (uint64_t)__builtin_popcountll(v);
+#endif
+}
+
+static inline bool walkable_ch(char ch){ return ch=='.' || ch=='F'; }   // same as Board::walkable
+
+// Cells off..n-1 one at a time: the partial word the vector loop left
+static void pack_tail(const char *cell, size_t off, size_t n, uint64_t *bits){
+    for(size_t i=off;i<n;i++) if(walkable_ch(cell[i])) bits[i >> 6] |= 1ull << (i & 63);
+}
+
+#if defined(__AVX2__)
+
+const char *bitboard_isa(){ return "avx2"; }
+
+void pack_walkable(const char *cell, size_t n, uint64_t *bits){
+    const __m256i dot = _mm256_set1_epi8('.'), flag = _mm256_set1_epi8('F');
+    auto mask32 = [&](const char *p){
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, dot), _mm256_cmpeq_epi8(v, flag));
+        return (uint64_t)(uint32_t)_mm256_movemask_epi8(m);
+    };
+    size_t k = 0;
+    for(; (k+1)*64 <= n; k++) bits[k] = mask32(cell + k*64) | mask32(cell + k*64 + 32) << 32;
+    if(k < bit_words(n)) bits[k] = 0;
+    pack_tail(cell, k*64, n, bits);
+}
+
+// Mula's nibble lookup: a byte's popcount is two shuffles, and sad adds 8 of them
+uint64_t popcount_bits(const uint64_t *w, size_t n){
+    const __m256i lut = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4, 0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i lo4 = _mm256_set1_epi8(0x0f);
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i+4 <= n; i+=4){
+        __m256i v = _mm256_loadu_si256((const __m256i*)(w + i));
+        __m256i c = _mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(v, lo4)),
+                                    _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), lo4)));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(c, _mm256_setzero_si256()));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    uint64_t total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for(; i<n; i++) total += popcount64(w[i]);
+    return total;
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+const char *bitboard_isa(){ return "neon"; }
+
+// No movemask on NEON: weight each lane's 0xff by its bit and fold pairwise
+void pack_walkable(const char *cell, size_t n, uint64_t *bits){
+    const uint8x16_t dot = vdupq_n_u8('.'), flag = vdupq_n_u8('F');
+    static const uint8_t W[16] = {1,2,4,8,16,32,64,128, 1,2,4,8,16,32,64,128};
+    const uint8x16_t wt = vld1q_u8(W);
+    auto lanes = [&](const char *p){
+        uint8x16_t v = vld1q_u8((const uint8_t*)p);
+        return vandq_u8(vorrq_u8(vceqq_u8(v, dot), vceqq_u8(v, flag)), wt);
+    };
+    size_t k = 0;
+    for(; (k+1)*64 <= n; k++){
+        const char *p = cell + k*64;
+        uint8x16_t ab = vpaddq_u8(lanes(p), lanes(p + 16)), cd = vpaddq_u8(lanes(p + 32), lanes(p + 48));
+        uint8x16_t s = vpaddq_u8(ab, cd);
+        s = vpaddq_u8(s, s);                             // byte j = bits 8j..8j+7
+        bits[k] = vgetq_lane_u64(vreinterpretq_u64_u8(s), 0);
+    }
+    if(k < bit_words(n)) bits[k] = 0;
+    pack_tail(cell, k*64, n, bits);
+}
+
+uint64_t popcount_bits(const uint64_t *w, size_t n){
+    uint64_t total = 0;
+    size_t i = 0;
+    for(; i+2 <= n; i+=2) total += vaddvq_u8(vcntq_u8(vreinterpretq_u8_u64(vld1q_u64(w + i))));
+    for(; i<n; i++) total += popcount64(w[i]);
+    return total;
+}
+
+#else
+
+#if defined(__SSE2__) || defined(_M_X64)
+
+const char *bitboard_isa(){ return "sse2"; }
+
+void pack_walkable(const char *cell, size_t n, uint64_t *bits){
+    const __m128i dot = _mm_set1_epi8('.'), flag = _mm_set1_epi8('F');
+    auto mask16 = [&](const char *p){
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        return (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, dot), _mm_cmpeq_epi8(v, flag)));
+    };
+    size_t k = 0;
+    for(; (k+1)*64 <= n; k++){
+        const char *p = cell + k*64;
+        bits[k] = mask16(p) | mask16(p + 16) << 16 | mask16(p + 32) << 32 | mask16(p + 48) << 48;
+    }
+    if(k < bit_words(n)) bits[k] = 0;
+    pack_tail(cell, k*64, n, bits);
+}
+
+#else
+
+const char *bitboard_isa(){ return "scalar"; }
+
+// SWAR: the high bit of each byte that equals '.' or 'F', gathered into 8 bits by one multiply
+static inline uint64_t walkable8(const char *p){
+    uint64_t w; memcpy(&w, p, 8);
+    const uint64_t lo7 = 0x7f7f7f7f7f7f7f7full;
+    auto nonzero = [&](uint64_t v){ return ((v & lo7) + lo7) | v; };   // high bit set per non-zero byte
+    const uint64_t hit = ~(nonzero(w ^ 0x2e2e2e2e2e2e2e2eull) & nonzero(w ^ 0x4646464646464646ull)) & ~lo7;
+    return ((hit >> 7) * 0x0102040810204080ull) >> 56;
+}
+
+void pack_walkable(const char *cell, size_t n, uint64_t *bits){
+    size_t k = 0;
+    for(; (k+1)*64 <= n; k++){
+        uint64_t v = 0;
+        for(int j=0;j<8;j++) v |= walkable8(cell + k*64 + j*8) << (j*8);
+        bits[k] = v;
+    }
+    if(k < bit_words(n)) bits[k] = 0;
+    pack_tail(cell, k*64, n, bits);
+}
+
+#endif
+
+uint64_t popcount_bits(const uint64_t *w, size_t n){
+    uint64_t total = 0;
+    for(size_t i=0;i<n;i++) total += popcount64(w[i]);
+    return total;
+}
+
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// ---- Bitboards ----
+// One bit per cell in the flat padded layout of Board::cell: bit i of the board
+// is bit i%64 of word i/64, so a cell index works unchanged on cell, occ and the
+// bits. 64 cells per word puts a 2000x4000 board in 1 MB, against 8 MB of cells
+// and 32 MB of occ, which is what a crowd of random lookups is bound by.
+
+inline size_t bit_words(size_t cells){ return (cells + 63) / 64; }
+inline bool test_bit(const uint64_t *w, size_t i){ return (w[i >> 6] >> (i & 63)) & 1; }
+
+#if defined(_MSC_VER)
+inline int ctz64(uint64_t v){ unsigned long i; _BitScanForward64(&i, v); return (int)i; }
+inline int clz64(uint64_t v){ unsigned long i; _BitScanReverse64(&i, v); return 63 - (int)i; }
+#else
+inline int ctz64(uint64_t v){ return __builtin_ctzll(v); }     // v != 0
+inline int clz64(uint64_t v){ return __builtin_clzll(v); }     // v != 0
+#endif
+
+// The scans read plain words (static bits) and atomic ones (Board::occBits) alike
+inline uint64_t word(uint64_t w){ return w; }
+inline uint64_t word(const std::atomic<uint64_t> &w){ return w.load(std::memory_order_relaxed); }
+
+// Lowest set bit in [lo, hi], or SIZE_MAX if none; whole words at a time
+template<class Word> inline size_t next_set(const Word *w, size_t lo, size_t hi){
+    size_t k = lo >> 6;
+    uint64_t v = word(w[k]) & (~0ull << (lo & 63));
+    for(;;){
+        if(v){ size_t i = (k << 6) + (size_t)ctz64(v); return i <= hi ? i : SIZE_MAX; }
+        if(++k > (hi >> 6)) return SIZE_MAX;
+        v = word(w[k]);
+    }
+}
+
+// Highest set bit in [lo, hi], or SIZE_MAX if none
+template<class Word> inline size_t prev_set(const Word *w, size_t lo, size_t hi){
+    size_t k = hi >> 6;
+    uint64_t v = word(w[k]) & (~0ull >> (63 - (hi & 63)));
+    for(;;){
+        if(v){ size_t i = (k << 6) + 63 - (size_t)clz64(v); return i >= lo ? i : SIZE_MAX; }
+        if(k-- == (lo >> 6)) return SIZE_MAX;
+        v = word(w[k]);
+    }
+}
+
+// Kernels: AVX2 with -DTOONS_NATIVE=ON on x86-64, NEON on AArch64, portable otherwise.
+// bits gets bit i set when cell[i] is walkable ('.' or 'F'); bits needs bit_words(n) words.
+void pack_walkable(const char *cell, size_t n, uint64_t *bits);
+
+// Set bits in w[0..n)
+uint64_t popcount_bits(const uint64_t *w, size_t n);
+
+// Name of the kernel set compiled in ("avx2", "neon" or "scalar")
+const char *bitboard_isa();
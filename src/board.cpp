@@ -0,0 +1,236 @@
+#include "board.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+
+#include "stats.hpp"
+
+using namespace std;
+
+Board::Board(int r, int c, int nToons)
+  : R(r), C(c), W(c + 2*PAD), layer(make_shared<Layer>()), occ((size_t)(r + 2*PAD)*W), occBits(bit_words(occ.size())), scr(r, c),
+    finishCol(c-1), n(nToons), kind(nToons), tr(nToons), tc(nToons), frozen_until(nToons, 0),
+    frozen(nToons), cooldown(nToons), cooldown_until(nToons, 0), steps(nToons,0) {
+    layer->cell.assign(occ.size(), '#');
+    cell = layer->cell.data();
+    for(auto &o : occ) o.store(-1, memory_order_relaxed);
+    for(auto &w : occBits) w.store(0, memory_order_relaxed);
+    for(int t=0;t<n;t++) kind[t] = (uint8_t)(t % NKINDS);
+    reset();
+}
+
+void Board::clear_toons(){
+    for(int t=0;t<n;t++) set_occupant(*this, idx(tr[t],tc[t]), -1);   // toons are all occ holds
+    fill(tr.begin(), tr.end(), 0); fill(tc.begin(), tc.end(), 0);
+    fill(frozen_until.begin(), frozen_until.end(), 0); fill(cooldown_until.begin(), cooldown_until.end(), 0);
+    fill(steps.begin(), steps.end(), 0);
+    for(int t=0;t<n;t++){ frozen[t].store(0, memory_order_relaxed); cooldown[t].store(0, memory_order_relaxed); }
+}
+
+void Board::reset(){
+    clear_toons();
+    // Every interior row is rewritten; the sentinel ring never changes
+    finishCol = C-1;
+    flag = {R/2, C-2};
+    for(int y=0;y<R;y++){
+        memset(edit_row(y), '.', C-1);
+        edit(y, finishCol) = '|';
+    }
+    edit(flag.r, flag.c) = 'F';
+    pack_open();
+    layer->dist.clear();                 // setup builds it again if the policy needs it;
+    dist = nullptr;                      // a stale field must not come back with the next edit
+    scr.dirty.clear();
+    render = true;
+}
+
+Layout Board::layout() const {
+    Layout l{layer, flag, finishCol, vector<Pos>(n)};
+    for(int t=0;t<n;t++) l.starts[t] = pos(t);
+    return l;
+}
+
+void Board::load(const Layout &l){
+    clear_toons();
+    layer = l.layer;                     // shared; a later edit copies it first
+    cell = layer->cell.data();
+    dist = layer->dist.empty() ? nullptr : layer->dist.data();
+    open = layer->open.data();
+    flag = l.flag; finishCol = l.finishCol;
+    for(int t=0;t<n;t++) place_toon(*this, t, l.starts[t]);
+    scr.dirty.clear();
+}
+
+Board::Board(const Board &proto)
+  : R(proto.R), C(proto.C), W(proto.W), layer(proto.layer), cell(proto.cell), dist(proto.dist), open(proto.open),
+    occ(proto.occ.size()), occBits(proto.occBits.size()), scr(R, C), finishCol(proto.finishCol), flag(proto.flag), n(proto.n), kind(proto.kind), tr(n), tc(n),
+    frozen_until(n, 0), frozen(n), cooldown(n), cooldown_until(n, 0), steps(n,0), render(false) {
+    for(auto &o : occ) o.store(-1, memory_order_relaxed);
+    for(auto &w : occBits) w.store(0, memory_order_relaxed);
+}
+
+Board::Layer &Board::unshared(){
+    if(layer.use_count() > 1) layer = make_shared<Layer>(*layer);
+    cell = layer->cell.data();
+    dist = layer->dist.empty() ? nullptr : layer->dist.data();
+    open = layer->open.empty() ? nullptr : layer->open.data();
+    return *layer;
+}
+
+void Board::pack_open(){
+    Layer &l = unshared();
+    l.open.resize(bit_words(l.cell.size()));
+    pack_walkable(l.cell.data(), l.cell.size(), l.open.data());
+    open = l.open.data();
+}
+
+string toon_name(const Board &b, int t){
+    return b.n <= NKINDS ? TOON_NM[t] : TOON_NM[b.kind[t]] + "#" + to_string(t);
+}
+
+void flag_dirs(const Board &b, int8_t *dr, int8_t *dc){
+    const int16_t fr = (int16_t)b.flag.r, fc = (int16_t)b.flag.c;
+    const int16_t *r = b.tr.data(), *c = b.tc.data();
+    for(int t=0;t<b.n;t++){
+        dr[t] = (int8_t)((fr > r[t]) - (fr < r[t]));
+        dc[t] = (int8_t)((fc > c[t]) - (fc < c[t]));
+    }
+}
+
+int nearest_target(const Board &b, int t){
+    const Pos me = b.pos(t);
+    if(b.n >= RING_SEARCH_MIN) return ring_target(b, me);
+    int target=-1, bestD=1e9;
+    for(int k=0;k<b.n;k++) if(k!=t){
+        if(b.frozen[k]) continue;
+        int d = abs(b.tr[k] - me.r) + abs(b.tc[k] - me.c);
+        if(d < bestD){ bestD=d; target=k; }
+    }
+    return target;
+}
+
+int ring_target(const Board &b, Pos me){
+    int target=-1, best=INT_MAX;
+    const auto *bits = b.occBits.data();
+    // Hit at cell i of a row a rows away: frozen toons are passed over, ties go to the lower index
+    auto hit = [&](size_t i, int a, int c){
+        int k = b.occupant(i);
+        if(k < 0 || b.frozen[k]) return false;
+        int d = a + abs(c - me.c);
+        if(d < best || (d == best && k < target)){ best = d; target = k; }
+        return true;
+    };
+    const int rows = max(me.r, b.R-1-me.r);
+    for(int a=0; a<=rows && a<=best; a++){
+        for(int s : {a, -a}){
+            const int r = me.r + s;
+            if(r < 0 || r >= b.R || (a == 0 && s < 0)) continue;
+            const int reach = best == INT_MAX ? b.C : best - a;   // columns either side that can still win
+            const size_t row = b.idx(r, 0);
+            // Right of (and, off the shooter's row, at) its column, then left of it
+            int c0 = a ? me.c : me.c+1, c1 = min(b.C-1, me.c + reach);
+            for(size_t i; c0 <= c1 && (i = next_set(bits, row + c0, row + c1)) != SIZE_MAX; c0 = (int)(i - row) + 1)
+                if(hit(i, a, (int)(i - row))) break;
+            c0 = max(0, me.c - reach); c1 = me.c - 1;
+            for(size_t i; c0 <= c1 && (i = prev_set(bits, row + c0, row + c1)) != SIZE_MAX; c1 = (int)(i - row) - 1)
+                if(hit(i, a, (int)(i - row))) break;
+        }
+    }
+    return target;
+}
+
+void setup_board(Board &board, const Options &opt){
+    mt19937 rng(opt.seed);
+    uniform_int_distribution<int> rr(0, board.R-1), cc(0, board.C-3);
+
+    // Sprinkle a few walls so jumps matter (about 3%)
+    int numWalls = (board.R*board.C)/30;
+    for(int i=0;i<numWalls;i++){
+        int r = rr(rng), c = cc(rng);
+        if(r==board.flag.r && c==board.flag.c){ --i; continue; }
+        board.edit(r,c) = '#';
+    }
+    board.pack_open();
+
+    random_starts(board, rng, 0);
+    if(opt.policy == Policy::FIELD) build_distance_field(board);
+}
+
+void random_starts(Board &board, mt19937 &rng, int from){
+    uniform_int_distribution<int> rr(0, board.R-1), cc(0, board.finishCol-2);
+    auto taken = [&](int r, int c){
+        return (r==board.flag.r && c==board.flag.c) || board.busy(board.idx(r,c)) || !test_bit(board.open, board.idx(r,c));
+    };
+    // Never on the flag, a wall or another toon. While most of the area is free a
+    // draw or two does it; a toon that misses START_TRIES times in a row (a
+    // crowded map) switches the rest over to the list of cells still free.
+    for(int t=from;t<board.n;t++){
+        int r,c,miss=0;
+        do{ r=rr(rng); c=cc(rng); } while(taken(r,c) && ++miss < START_TRIES);
+        if(miss == START_TRIES){ free_starts(board, rng, t); return; }
+        place_toon(board, t, {r,c});
+    }
+}
+
+void free_starts(Board &board, mt19937 &rng, int from){
+    static thread_local vector<uint32_t> cells;   // scratch, kept so batch races do not allocate
+    cells.clear();
+    const size_t flag = board.idx(board.flag.r, board.flag.c);
+    for(int r=0;r<board.R;r++){
+        const size_t lo = board.idx(r, 0), hi = board.idx(r, board.finishCol-2);
+        for(size_t i = lo; (i = next_set(board.open, i, hi)) != SIZE_MAX; i++)
+            if(i != flag && !board.busy(i)) cells.push_back((uint32_t)i);
+    }
+    // Callers guarantee the room: clamp_options caps toons for generated boards
+    // and MapFile rejects a map without enough open cells
+    assert(cells.size() >= (size_t)(board.n - from) && "more toons than free cells");
+    // Swap-remove: every pick is one draw over the cells left
+    for(int t=from;t<board.n;t++){
+        const size_t k = uniform_int_distribution<size_t>(0, cells.size()-1)(rng);
+        const size_t i = cells[k];
+        cells[k] = cells.back(); cells.pop_back();
+        place_toon(board, t, {(int)(i / board.W) - Board::PAD, (int)(i % board.W) - Board::PAD});
+    }
+}
+
+void build_distance_field(Board &b){
+    Board::Layer &l = b.unshared();
+    const size_t N = l.cell.size();
+    l.dist.resize(N);
+    int32_t *dist = l.dist.data();
+    const char *cell = l.cell.data();
+    b.dist = dist;
+    // Walls (and the sentinel ring) start out "visited" at WALL, so the search
+    // tests one array and never needs a bounds check
+    constexpr int32_t WALL = -1, TODO = Board::UNREACHABLE - 1;
+    for(size_t i=0;i<N;i++) dist[i] = Board::walkable(cell[i]) ? TODO : WALL;
+    static thread_local vector<uint32_t> q;   // scratch, kept so batch races do not allocate
+    q.resize((size_t)b.R*b.C);
+    size_t head = 0, tail = 0;
+    for(int r=0;r<b.R;r++){
+        size_t i = b.idx(r, b.finishCol-1);
+        if(dist[i] == TODO){ dist[i] = 0; q[tail++] = (uint32_t)i; }
+    }
+    const ptrdiff_t off[4] = {-(ptrdiff_t)b.W, (ptrdiff_t)b.W, -1, 1};
+    while(head < tail){
+        size_t i = q[head++];
+        int32_t d = dist[i] + 1;
+        for(ptrdiff_t o : off){
+            size_t j = i + o;
+            if(dist[j] == TODO){ dist[j] = d; q[tail++] = (uint32_t)j; }
+        }
+    }
+    for(size_t i=0;i<N;i++) if(dist[i] < 0 || dist[i] == TODO) dist[i] = Board::UNREACHABLE;
+}
+
+Density board_density(const Board &b){
+    return {(uint64_t)b.R*b.C, popcount_bits(b.open, b.layer->open.size()), b.n};
+}
+
+void rebuild_grid(Board &b){
+    PhaseTimer pt(REBUILD);
+    for(int r=0;r<b.R;r++) memcpy(&b.px(r,0), b.row(r), b.C);   // finish line and flag are static cells
+    for(int t=0;t<b.n;t++) b.px(b.tr[t], b.tc[t]) = toon_glyph(b,t);
+    b.scr.dirty.clear();
+}
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bitboard.hpp"
+#include "options.hpp"
+#include "rng.hpp"
+
+struct Pos { int r; int c; };
+
+enum Toon : uint8_t { ROADRUNNER=0, COYOTE=1, YOSEMITESAM=2 }; // R, C, Y
+static constexpr int NKINDS = 3;     // toon t is archetype t % NKINDS
+inline const std::vector<char>        TOON_CH = {'R','C','Y'};
+inline const std::vector<std::string> TOON_NM = {"RoadRunner","Coyote","YosemiteSam"};
+inline const std::vector<int>         TOON_PERIOD_MS = {35, 60, 75};   // pace per archetype (RoadRunner is fastest)
+
+// Render buffer plus the terminal-side state needed to draw it. Board owns the
+// model copy; the renderer thread keeps its own copy of what is on screen.
+struct Screen {
+    int R, C;
+    std::vector<char> grid;              // R*C row-major
+    std::vector<uint32_t> dirty;         // cells (r*C+c) patched since the last frame
+    std::string frame;                   // reusable output buffer
+    bool live = false;                   // redraw in place (ANSI) instead of stacking frames
+    bool shown = false;                  // live: a full frame is already on screen
+    int steps_hint = 0;                  // renderer: steps shown with the pending frame
+
+    Screen(int r, int c) : R(r), C(c), grid((size_t)r*c, '.') {}
+    char &px(int r, int c)       { return grid[(size_t)r*C + c]; }
+    char  px(int r, int c) const { return grid[(size_t)r*C + c]; }
+};
+
+struct Layout;
+
+// Static cells live in one row-major buffer with a PAD-wide ring of '#' around
+// the track, so the move path never needs a bounds check: Coyote's hop reaches
+// at most two cells past the edge and always lands on a sentinel wall.
+// The static layer (cells and distance field) is shared copy-on-write: forks of
+// a board point at the same one, and edit()/edit_row()/unshared() copy it first
+// if anyone else still holds it. Reads go through the cell/dist pointers.
+// Bitboards sit beside them for the scans: open (walkable cells; pack_open()
+// refreshes it after the cells are edited) and occBits (occ >= 0, changed with occ).
+struct Board {
+    static constexpr int PAD = 2;
+    static constexpr int32_t UNREACHABLE = INT32_MAX;
+    struct Layer {
+        std::vector<char> cell;          // static cells ('.', '#', '|', 'F') + sentinel ring
+        std::vector<int32_t> dist;       // --policy field: steps to the goal column (same layout), UNREACHABLE if none
+        std::vector<uint64_t> open;      // walkable bits of cell
+    };
+    int R, C;
+    int W;                               // row stride of cell (C + 2*PAD)
+    std::shared_ptr<Layer> layer;
+    const char *cell;                    // layer->cell
+    const int32_t *dist = nullptr;       // layer->dist, null until built
+    const uint64_t *open = nullptr;      // layer->open
+    std::vector<std::atomic<int32_t>> occ; // toon id per cell (same layout as cell), -1 = empty; CAS'd by --sync cas
+    std::vector<std::atomic<uint64_t>> occBits; // occ >= 0, one bit per cell
+    Screen scr;                          // render buffer (model side)
+    int finishCol;                       // right wall
+    Pos flag;                            // goal
+
+    std::mutex mtx;                      // state lock
+
+    // Toon state as parallel arrays, ~19 bytes per toon
+    int n;                               // number of toons
+    std::vector<uint8_t>  kind;          // archetype (Toon)
+    std::vector<int16_t>  tr, tc;        // position
+    std::vector<uint32_t> frozen_until;  // race clock (ms) of the pending thaw
+    std::vector<std::atomic<uint8_t>> frozen;   // frozen until its THAW timer fires (drawn lowercase)
+    std::vector<std::atomic<uint8_t>> cooldown; // ability recharging until its READY timer fires
+    std::vector<uint32_t> cooldown_until; // race clock (ms) of the pending READY
+    std::vector<uint32_t> steps;         // per-toon step count
+
+    bool render = true;                  // keep scr patched as toons move (off in headless)
+
+    Board(int r, int c, int nToons);
+    // Fork: shares proto's static layer, flag and toon kinds; no toons placed yet
+    // (HeadlessRace::restore puts a snapshot on it)
+    explicit Board(const Board &proto);
+    Board &operator=(const Board &) = delete;
+    // Back to the state the constructor leaves (open track, no toons placed), keeping every buffer
+    void reset();
+    // The set-up board as a Layout, and back: load() shares the layout's layer
+    // instead of copying it, and puts every toon on its start cell
+    Layout layout() const;
+    void load(const Layout &l);
+    Layer &unshared();                   // sole-owner layer, for writes
+    void pack_open();                    // rebuild open from cell; every static edit ends with it
+    bool inBounds(int r, int c) const { return (r>=0 && r<R && c>=0 && c<C); }
+    Pos pos(int t) const { return {tr[t], tc[t]}; }
+
+    size_t idx(int r, int c) const { return (size_t)(r+PAD)*W + (c+PAD); }
+    char  at(int r, int c) const { return cell[idx(r,c)]; }
+    const char *row(int r) const { return &cell[idx(r,0)]; }
+    char &edit(int r, int c)     { return unshared().cell[idx(r,c)]; }
+    char *edit_row(int r)        { return &unshared().cell[idx(r,0)]; }
+    char &px(int r, int c)       { return scr.px(r,c); }
+    char  px(int r, int c) const { return scr.px(r,c); }
+    int32_t occupant(size_t i) const { return occ[i].load(std::memory_order_relaxed); }
+    bool busy(size_t i) const { return (word(occBits[i >> 6]) >> (i & 63)) & 1; }
+    static bool walkable(char ch){ return ch=='.' || ch=='F'; }  // '#' walls, '|' finish line
+private:
+    void clear_toons();
+};
+
+// Everything a set-up board has before its race starts: static layer, goal and
+// start cells. Any number of boards of the same size and toon count can race on
+// one at once (--sweep shares each across its workers).
+struct Layout {
+    std::shared_ptr<Board::Layer> layer;
+    Pos flag;
+    int finishCol;
+    std::vector<Pos> starts;             // per toon
+};
+
+template<class Rng> inline Pos pick_step(Rng &rng){
+    static const Pos dirs[5] = {{-1,0},{1,0},{0,-1},{0,1},{0,0}}; // 4-neigh + stay
+    return dirs[below(rng, 5)];
+}
+
+// ---- Movement rules shared by the threaded and headless engines ----
+
+std::string toon_name(const Board &b, int t);
+
+inline Pos flag_dir(const Board &b, Pos cur){
+    return { (b.flag.r > cur.r) - (b.flag.r < cur.r), (b.flag.c > cur.c) - (b.flag.c < cur.c) };
+}
+
+// Flag direction of every toon in one pass over the position arrays. A toon's
+// direction only depends on its own position, which no other toon changes, so
+// a tick can compute them all up front in a loop the compiler vectorizes.
+void flag_dirs(const Board &b, int8_t *dr, int8_t *dc);
+
+// Bias toward flag most of the time
+template<class Rng> inline Pos choose_step(Pos dir, Rng &rng){
+    if (uniform01(rng) < 0.70) {
+        if (below(rng, 2)==0 && dir.r!=0) return {dir.r,0};
+        if (dir.c!=0) return {0,dir.c};
+    }
+    return pick_step(rng);
+}
+
+// RoadRunner burst: one extra step straight toward the flag
+template<class Rng> inline Pos burst_step(const Board &b, int t, Rng &rng){
+    Pos dir = flag_dir(b, b.pos(t));
+    return (std::abs(dir.r)+std::abs(dir.c) ? Pos{ (dir.r!=0)?dir.r:0, (dir.r==0)?dir.c:0 } : pick_step(rng));
+}
+
+// Can toon t step onto p (inside the track, not a wall, not another toon)?
+// p may be up to PAD cells outside the board; the sentinel ring rejects it.
+inline bool can_enter(const Board &b, int t, Pos p){
+    size_t i = b.idx(p.r,p.c);
+    int32_t k = b.occupant(i);
+    return Board::walkable(b.cell[i]) && (k < 0 || k == t);
+}
+
+// occ and occBits together, for a single writer (headless, lock mode, setup, replay)
+inline void set_occupant(Board &b, size_t i, int32_t t){
+    b.occ[i].store(t, std::memory_order_relaxed);
+    std::atomic<uint64_t> &w = b.occBits[i >> 6];
+    const uint64_t m = 1ull << (i & 63), v = w.load(std::memory_order_relaxed);
+    w.store(t >= 0 ? v | m : v & ~m, std::memory_order_relaxed);
+}
+
+inline void place_toon(Board &b, int t, Pos p){
+    b.tr[t] = (int16_t)p.r; b.tc[t] = (int16_t)p.c;
+    set_occupant(b, b.idx(p.r,p.c), t);
+}
+
+// ---- Incremental render buffer ----
+// grid mirrors the static cells plus one glyph per toon. Moves and freezes patch
+// only the cells they touch and queue them in dirty, so a move costs O(1)
+// instead of a full rebuild_grid pass.
+
+inline char toon_glyph(const Board &b, int t){
+    char ch = TOON_CH[b.kind[t]];
+    return b.frozen[t] ? (char)std::tolower(ch) : ch;
+}
+
+inline void patch(Board &b, Pos p, char ch){
+    b.px(p.r,p.c) = ch;
+    b.scr.dirty.push_back((uint32_t)(p.r*b.C + p.c));
+}
+
+// Shared: other threads move toons on the same occBits words at the same time
+// (--sched tiles lanes), so the bits change with atomic or/and instead
+template<bool Shared = false> inline void move_toon(Board &b, int t, Pos dest){
+    Pos old = b.pos(t);
+    const size_t from = b.idx(old.r,old.c), to = b.idx(dest.r,dest.c);
+    b.occ[from].store(-1, std::memory_order_relaxed);
+    b.occ[to].store(t, std::memory_order_relaxed);
+    b.tr[t] = (int16_t)dest.r; b.tc[t] = (int16_t)dest.c; b.steps[t]++;
+    std::atomic<uint64_t> &wf = b.occBits[from >> 6], &wt = b.occBits[to >> 6];
+    if constexpr(Shared){
+        wf.fetch_and(~(1ull << (from & 63)), std::memory_order_relaxed);
+        wt.fetch_or(1ull << (to & 63), std::memory_order_relaxed);
+    } else {
+        // Both bits in one read-modify-write when the step stays inside a word (most sideways steps)
+        const uint64_t v = wf.load(std::memory_order_relaxed) & ~(1ull << (from & 63));
+        if(&wf == &wt) wf.store(v | 1ull << (to & 63), std::memory_order_relaxed);
+        else { wf.store(v, std::memory_order_relaxed); wt.store(wt.load(std::memory_order_relaxed) | 1ull << (to & 63), std::memory_order_relaxed); }
+    }
+    if(b.render){ patch(b, old, b.at(old.r,old.c)); patch(b, dest, toon_glyph(b,t)); }
+}
+
+// ---- Lock-free moves (--sync cas) ----
+// A toon claims its destination with one CAS on occ and only releases the cell
+// it leaves afterwards, so two toons never share a cell and no lock is taken.
+// Only the owning worker writes a toon's position and step count. Workers share
+// occBits words, so the bit follows the CAS with an atomic or/and; it may lag
+// occ for a moment, which only the ring search sees.
+
+inline bool claim_cell(Board &b, int t, Pos p){
+    size_t i = b.idx(p.r,p.c);
+    int32_t empty = -1;
+    if(!Board::walkable(b.cell[i]) || !b.occ[i].compare_exchange_strong(empty, t, std::memory_order_acquire, std::memory_order_relaxed)) return false;
+    b.occBits[i >> 6].fetch_or(1ull << (i & 63), std::memory_order_relaxed);
+    return true;
+}
+
+inline void release_cell(Board &b, Pos p){
+    size_t i = b.idx(p.r,p.c);
+    b.occBits[i >> 6].fetch_and(~(1ull << (i & 63)), std::memory_order_relaxed);
+    b.occ[i].store(-1, std::memory_order_release);
+}
+
+inline void set_frozen(Board &b, int t, bool on){
+    if(b.frozen[t] == (uint8_t)on) return;
+    b.frozen[t] = on;
+    if(b.render) patch(b, b.pos(t), toon_glyph(b,t));
+}
+
+inline bool at_goal(const Board &b, Pos p){
+    return (p.r==b.flag.r && p.c==b.flag.c) || p.c >= b.finishCol-1;
+}
+
+// ---- Distance field (--policy field) ----
+// Multi-source BFS over the static cells from every goal cell (the column in
+// front of the finish line, which holds the flag). Walls never change after
+// setup, so it is built once per board; toons are not obstacles in it.
+void build_distance_field(Board &b);
+
+// Neighbour of toon t that is closest to the goal and free right now, or {0,0}
+// if none is closer than where it stands (boxed in, or another toon in the way).
+inline Pos field_descent(const Board &b, int t){
+    static const Pos dirs[4] = {{-1,0},{1,0},{0,-1},{0,1}};
+    const Pos cur = b.pos(t);
+    int32_t best = b.dist[b.idx(cur.r,cur.c)];
+    Pos step{0,0};
+    for(Pos d : dirs){
+        Pos p{cur.r + d.r, cur.c + d.c};
+        int32_t v = b.dist[b.idx(p.r,p.c)];
+        if(v < best && can_enter(b,t,p)){ best = v; step = d; }
+    }
+    return step;
+}
+
+// Same 70% bias as choose_step, but downhill on the field instead of toward the flag
+template<class Rng> inline Pos field_step(const Board &b, int t, Rng &rng){
+    if (uniform01(rng) < 0.70) {
+        Pos s = field_descent(b, t);
+        if (s.r || s.c) return s;
+    }
+    return pick_step(rng);
+}
+
+template<class Rng> inline Pos field_burst(const Board &b, int t, Rng &rng){
+    Pos s = field_descent(b, t);
+    return (s.r || s.c) ? s : pick_step(rng);
+}
+
+// --policy as types, so an engine picks one per race and its turn loop carries
+// no policy test. dir is flag_dir of the toon's cell, cached where the policy
+// wants it (wantsDir).
+struct GreedySteps {
+    static constexpr bool wantsDir = true;
+    template<class Rng> static Pos step(const Board &, int, Pos dir, Rng &rng){ return choose_step(dir, rng); }
+    template<class Rng> static Pos burst(const Board &b, int t, Rng &rng){ return burst_step(b, t, rng); }
+};
+struct FieldSteps {
+    static constexpr bool wantsDir = false;
+    template<class Rng> static Pos step(const Board &b, int t, Pos, Rng &rng){ return field_step(b, t, rng); }
+    template<class Rng> static Pos burst(const Board &b, int t, Rng &rng){ return field_burst(b, t, rng); }
+};
+
+// YosemiteSam targeting: nearest unfrozen toon (Manhattan), lowest index on ties.
+// Few toons: scan them. Crowds: scan rows outward from the shooter on occBits,
+// finding the closest taken cell on each side of its column a word at a time;
+// it stops once the row distance alone exceeds the best hit, and never looks at
+// the toon list.
+static constexpr int RING_SEARCH_MIN = 64;
+int nearest_target(const Board &b, int t);
+
+// The ring search alone, from a given cell. It reads nothing but occBits, occ
+// and frozen, so --sync cas workers can call it while other toons move.
+int ring_target(const Board &b, Pos me);
+
+// Walls and random start positions, all drawn from opt.seed; builds the distance
+// field when opt.policy needs it
+void setup_board(Board &board, const Options &opt);
+
+// Places toons from..n-1 on free cells left of the goal column; the caller makes
+// sure there are enough of them. Rejection draws over the area while they keep
+// hitting, free_starts once they do not, so each toon costs O(1) draws either way.
+static constexpr int START_TRIES = 32;
+void random_starts(Board &board, std::mt19937 &rng, int from);
+// Lists the cells still free (one bitboard scan) and draws toons from..n-1 from it
+void free_starts(Board &board, std::mt19937 &rng, int from);
+
+// Open cells (popcount of open; the sentinel ring has none) per toon on the board
+struct Density { uint64_t cells, open; int toons; };
+Density board_density(const Board &b);
+
+// Full repaint; only needed for the first and last frame
+void rebuild_grid(Board &b);
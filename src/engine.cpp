@@ -0,0 +1,303 @@
+#include "engine.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "render.hpp"
+#include "replay.hpp"
+
+using namespace std;
+
+atomic<bool> gStop(false);
+
+HeadlessRace::HeadlessRace(const Options &o, Board &b, ReplayWriter *log, int nLanes)
+  : opt(o), board(b), tick_ms(max(1, o.delay_ms)), event(o.sched == Sched::EVENT), tiled(o.sched == Sched::TILES),
+    dr(b.n), dc(b.n), rec(log) {
+    if(opt.rng == RngKind::XOSHIRO) fast = toon_streams<FastRng>(opt.seed, board.n);
+    else mt = toon_streams<mt19937>(opt.seed, board.n);
+    timers.reserve(2*(size_t)board.n);   // at most one thaw and one cooldown per toon
+    ready.reserve(board.n); due.reserve(board.n);
+    if(tiled){
+        // The log is written in turn order, so a recorded race keeps to one lane
+        if(rec) nLanes = 1;
+        if(nLanes > 1) pool = make_unique<LanePool>(nLanes);
+        lanes.resize(max(1, nLanes));
+        shots.reserve(board.n);
+    }
+    rewind();
+}
+
+void HeadlessRace::rewind(){
+    board.render = false;
+    now = 0; res = RaceResult();
+    timers.reset(0);
+    due.clear();
+    if(event) for(int t=0;t<board.n;t++) push_due(TOON_PERIOD_MS[board.kind[t]], t);
+    // The policy and rng are fixed for the race, so the branch on them is taken here once
+    with_policy(opt.policy, [&](auto steps){
+        using Steps = decltype(steps);
+        if(fast.empty()) play = event ? &HeadlessRace::events<Steps, mt19937> : tiled ? &HeadlessRace::tiles<Steps, mt19937> : &HeadlessRace::turns<Steps, mt19937>;
+        else play = event ? &HeadlessRace::events<Steps, FastRng> : tiled ? &HeadlessRace::tiles<Steps, FastRng> : &HeadlessRace::turns<Steps, FastRng>;
+    });
+}
+
+void HeadlessRace::reset(){
+    reseed(opt.seed);
+    rewind();
+}
+
+// YosemiteSam t fires: freeze the nearest toon, start the cooldown
+void HeadlessRace::shoot(int t, long long at, ThreadStats &st){
+    int target = nearest_target(board, t);
+    if(target!=-1){
+        freeze_toon(board, timers, target, now + opt.sam_freeze_ms);
+        if(rec) rec->add(at, ReplayRecord::FREEZE, target, (uint32_t)t, (uint32_t)opt.sam_freeze_ms);
+        st.add(FROZEN_MS, (uint64_t)opt.sam_freeze_ms);
+        res.freezes++;
+    }
+    st.add(SHOTS); res.shots++;
+    start_cooldown(board, timers, t, now + opt.sam_cooldown_ms);
+}
+
+// One turn of toon t; true if it won. Archetype rules compile in only for K.
+template<uint8_t K, class Steps, bool Tiled, class Rng> bool HeadlessRace::turn(int t, Rng &rng, ThreadStats &st, Lane &lane){
+    const long long at = stamp();
+    auto stepped = [&]{ if constexpr(Tiled) lane.steps++; else res.totalSteps++; };
+    auto count = [&](int Lane::*l, int RaceResult::*r){ if constexpr(Tiled) lane.*l += 1; else res.*r += 1; };
+    auto won = [&]{
+        if constexpr(Tiled){ if(lane.winner < 0 || t < lane.winner) lane.winner = t; }
+        else { res.winner=t; if(rec) rec->add(at, ReplayRecord::WIN, t); }
+        return true;
+    };
+
+    Pos step = Steps::step(board, t, {dr[t], dc[t]}, rng);
+    Pos cur = board.pos(t);
+    Pos nxt{cur.r + step.r, cur.c + step.c};
+    // A failed jump leaves the board as it was, so nxt is tested once for both moves
+    const bool open = can_enter(board,t,nxt);
+    bool moved=false;
+
+    // Coyote: jump over one cell sometimes when blocked
+    if constexpr(K == COYOTE){
+        if(!open && uniform01(rng) < opt.coy_jump_chance){
+            Pos hop{nxt.r + step.r, nxt.c + step.c};
+            if(can_enter(board,t,hop)){
+                if(rec) rec->add(at, ReplayRecord::JUMP, t, cell_id(board,cur), cell_id(board,hop));
+                move_toon<Tiled>(board,t,hop); moved=true; stepped(); count(&Lane::jumps, &RaceResult::jumps);
+                st.add(JUMPS); st.add(MOVES);
+            }
+        }
+    }
+    if(!moved && open){
+        if(rec) rec->add(at, ReplayRecord::MOVE, t, cell_id(board,cur), cell_id(board,nxt));
+        move_toon<Tiled>(board,t,nxt); moved=true; stepped();
+        st.add(MOVES);
+    } else if(!moved) st.add(BLOCKED);
+    if(at_goal(board, board.pos(t))) return won();
+
+    // YosemiteSam: fire & freeze with cooldown (tiled: once the tick's moves are done)
+    if constexpr(K == YOSEMITESAM){
+        if(!board.cooldown[t] && uniform01(rng) < opt.sam_shoot_chance){
+            if constexpr(Tiled) lane.shots.push_back(t); else shoot(t, at, st);
+        }
+    }
+
+    // RoadRunner: occasional burst (extra step toward flag)
+    if constexpr(K == ROADRUNNER){
+        if(moved && uniform01(rng) < opt.rr_burst_chance){
+            Pos s2 = Steps::burst(board, t, rng);
+            Pos p2{board.tr[t] + s2.r, board.tc[t] + s2.c};
+            if(can_enter(board,t,p2)){
+                if(rec) rec->add(at, ReplayRecord::MOVE, t, cell_id(board,board.pos(t)), cell_id(board,p2));
+                move_toon<Tiled>(board,t,p2); stepped(); count(&Lane::bursts, &RaceResult::bursts);
+                st.add(BURSTS); st.add(MOVES);
+            }
+            if(at_goal(board, board.pos(t))) return won();
+        }
+    }
+    return false;
+}
+
+// Toon t is archetype t % NKINDS, so the loop walks R, C, Y triples and never
+// looks kind up; the || chain keeps index order and stops at a win
+template<class Steps, class Rng> void HeadlessRace::turns(){
+    static_assert(NKINDS == 3 && ROADRUNNER == 0 && COYOTE == 1 && YOSEMITESAM == 2, "turns() unrolls R, C, Y");
+    if constexpr(Steps::wantsDir) flag_dirs(board, dr.data(), dc.data());
+    ThreadStats &st = stats_local();
+    vector<Rng> &trng = streams<Rng>();
+    Lane none;
+    auto act = [&](auto kind, int t){
+        if(board.frozen[t]){ st.add(FROZEN_TURNS); return false; }
+        return turn<decltype(kind)::value, Steps, false>(t, trng[t], st, none);
+    };
+    const int n = board.n;
+    int t = 0;
+    for(; t + NKINDS <= n; t += NKINDS)
+        if(act(KindTag<ROADRUNNER>{}, t) || act(KindTag<COYOTE>{}, t+1) || act(KindTag<YOSEMITESAM>{}, t+2)) return;
+    if(t < n && !act(KindTag<ROADRUNNER>{}, t) && t+1 < n) act(KindTag<COYOTE>{}, t+1);
+}
+
+// Every toon due at the earliest timestamp acts, in index order, then goes back
+// in the queue one period later; a frozen toon goes back at its thaw instead
+template<class Steps, class Rng> void HeadlessRace::events(){
+    ThreadStats &st = stats_local();
+    vector<Rng> &trng = streams<Rng>();
+    Lane none;
+    ready.clear();
+    while(!due.empty() && due.front().first == now){
+        ready.push_back(due.front().second);
+        pop_heap(due.begin(), due.end(), greater<Due>()); due.pop_back();
+    }
+    for(int t : ready){
+        if(board.frozen[t]){
+            st.add(FROZEN_TURNS);
+            push_due(max<long long>(board.frozen_until[t], now+1), t);
+            continue;
+        }
+        if constexpr(Steps::wantsDir){ Pos d = flag_dir(board, board.pos(t)); dr[t] = (int8_t)d.r; dc[t] = (int8_t)d.c; }
+        if(with_kind(board.kind[t], [&](auto kind){ return turn<decltype(kind)::value, Steps, false>(t, trng[t], st, none); })) return;
+        push_due(now + TOON_PERIOD_MS[board.kind[t]], t);
+    }
+}
+
+// Colour by colour, every busy tile runs its toons in index order. Tiles of a
+// colour are independent, so it does not matter which lane runs which.
+template<class Steps, class Rng> void HeadlessRace::tiles(){
+    if constexpr(Steps::wantsDir) flag_dirs(board, dr.data(), dc.data());
+    tileMap.build(board);
+    vector<Rng> &trng = streams<Rng>();
+    for(const vector<uint32_t> &busy : tileMap.busy){
+        auto run = [&](int lane, uint32_t i){
+            ThreadStats &st = stats_local();
+            Lane &l = lanes[lane];
+            const uint32_t k = busy[i];
+            for(uint32_t j = tileMap.first[k]; j < tileMap.first[k+1]; j++){
+                const int t = tileMap.toons[j];
+                if(board.frozen[t]){ st.add(FROZEN_TURNS); continue; }
+                if(with_kind(board.kind[t], [&](auto kind){ return turn<decltype(kind)::value, Steps, true>(t, trng[t], st, l); })) break;
+            }
+        };
+        if(pool && busy.size() > 1) pool->run((uint32_t)busy.size(), run);
+        else for(uint32_t i=0;i<busy.size();i++) run(0, i);
+
+        int winner = -1;
+        for(Lane &l : lanes){
+            res.totalSteps += l.steps; res.jumps += l.jumps; res.bursts += l.bursts;
+            l.steps = l.jumps = l.bursts = 0;
+            if(l.winner >= 0 && (winner < 0 || l.winner < winner)) winner = l.winner;
+            l.winner = -1;
+        }
+        if(winner >= 0){
+            res.winner = winner;
+            if(rec) rec->add(stamp(), ReplayRecord::WIN, winner);
+            for(Lane &l : lanes) l.shots.clear();
+            return;
+        }
+    }
+
+    shots.clear();
+    for(Lane &l : lanes){ shots.insert(shots.end(), l.shots.begin(), l.shots.end()); l.shots.clear(); }
+    sort(shots.begin(), shots.end());
+    ThreadStats &st = stats_local();
+    for(int t : shots) shoot(t, stamp(), st);
+}
+
+void HeadlessRace::tick(){
+    ++res.ticks;
+    if(event) now = due.empty() ? now + tick_ms : due.front().first;
+    else now += tick_ms;
+    timers.advance(now, [&](const Timer &tm){
+        fire_timer(board, tm);
+        if(rec && tm.kind == Timer::THAW) rec->add(stamp(), ReplayRecord::THAW, tm.toon);
+    });
+    (this->*play)();
+}
+
+RaceSnapshot HeadlessRace::snapshot() const {
+    RaceSnapshot s;
+    s.now = now; s.res = res;
+    s.toons.resize(board.n);
+    for(int t=0;t<board.n;t++)
+        s.toons[t] = {board.tr[t], board.tc[t], board.frozen[t].load(memory_order_relaxed), board.cooldown[t].load(memory_order_relaxed),
+                      board.frozen_until[t], board.cooldown_until[t], board.steps[t]};
+    s.due = due; s.mt = mt; s.fast = fast;
+    return s;
+}
+
+void HeadlessRace::restore(const RaceSnapshot &s){
+    for(int t=0;t<board.n;t++) set_occupant(board, board.idx(board.tr[t], board.tc[t]), -1);
+    now = s.now; res = s.res;
+    timers.reset(now);
+    for(int t=0;t<board.n;t++){
+        const ToonState &ts = s.toons[t];
+        place_toon(board, t, {ts.r, ts.c});
+        board.steps[t] = ts.steps;
+        board.frozen[t] = ts.frozen; board.frozen_until[t] = ts.thaw_at;
+        board.cooldown[t] = ts.cooldown; board.cooldown_until[t] = ts.ready_at;
+        if(ts.frozen) timers.schedule({Timer::THAW, t, ts.thaw_at});
+        if(ts.cooldown) timers.schedule({Timer::READY, t, ts.ready_at});
+    }
+    due = s.due; mt = s.mt; fast = s.fast;
+}
+
+void HeadlessRace::reseed(unsigned seed){
+    if(fast.empty()) reseed_streams(mt, seed); else reseed_streams(fast, seed);
+}
+
+RaceResult run_headless(const Options &opt, Board &board, ReplayWriter *log){
+    HeadlessRace race(opt, board, log, opt.sched == Sched::TILES ? opt.jobs : 1);
+    while(!race.done()) race.tick();
+    return race.result();
+}
+
+int run_event_view(const Options &opt, Board &board, ReplayWriter *log){
+    HeadlessRace race(opt, board, log);
+    board.render = true;                 // moves patch the frame; no rebuild per tick
+    rebuild_grid(board);
+    FrameGate gate(opt);
+    if(gate.boards()) print_board(board.scr, 0);
+    const auto t0 = chrono::steady_clock::now();
+    bool shown = true;                   // the last frame made was printed
+    while(!race.done()){
+        race.tick();
+        const RaceResult r = race.result();
+        if(!(shown = gate.take(r.ticks, r.sim_ms))){ skip_frame(board.scr); continue; }
+        if(gate.all()){
+            PhaseTimer nap(SLEEP);
+            this_thread::sleep_until(t0 + chrono::milliseconds(r.sim_ms));
+        }
+        print_board(board.scr, r.totalSteps);
+    }
+    if(!shown) print_board(board.scr, race.result().totalSteps);
+    end_live(board.scr);
+    const RaceResult res = race.result();
+    print_summary(board, res.winner);
+    cout << "Ticks: " << res.ticks << " (simulated " << res.sim_ms << " ms)\n";
+    return 0;
+}
+
+void print_summary(const Board &b, int winner){
+    if(winner<0) return;
+    cout << "=== Final Summary ===\n";
+    if(b.n <= NKINDS){
+        for(int t=0;t<b.n;t++) cout << TOON_NM[t] << " (" << TOON_CH[t] << ") steps: " << b.steps[t] << "\n";
+    } else {
+        // Crowds: one line per archetype
+        for(int k=0;k<NKINDS;k++){
+            uint64_t cnt=0, sum=0; uint32_t best=0;
+            for(int t=k;t<b.n;t+=NKINDS){ cnt++; sum += b.steps[t]; best = max(best, b.steps[t]); }
+            cout << TOON_NM[k] << " (" << TOON_CH[k] << ") x" << cnt << " steps: " << sum << " total, " << best << " max\n";
+        }
+    }
+    cout << "Winner: " << toon_name(b, winner) << "\n";
+}
+
+void print_density(const Board &b){
+    const Density d = board_density(b);
+    cout << "Board: " << b.R << "x" << b.C << ", " << d.open << " open cells (" << fixed << setprecision(1)
+         << 100.0*d.open/max<uint64_t>(1, d.cells) << "%), " << d.toons << " toons on "
+         << setprecision(2) << 100.0*d.toons/max<uint64_t>(1, d.open) << "% of them  [bitboards: " << bitboard_isa() << "]\n" << flush;   // frames bypass cout
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "board.hpp"
+#include "options.hpp"
+#include "rng.hpp"
+#include "stats.hpp"
+#include "tiles.hpp"
+#include "timers.hpp"
+
+class ReplayWriter;
+
+extern std::atomic<bool> gStop;          // set by SIGINT; every engine polls it
+
+// Archetype and --policy as compile-time tags: f(std::integral_constant<uint8_t, K>{})
+// or f(GreedySteps{}) / f(FieldSteps{}), so f's body is specialized by if constexpr
+template<uint8_t K> using KindTag = std::integral_constant<uint8_t, K>;
+template<class F> inline decltype(auto) with_kind(uint8_t kind, F &&f){
+    switch(kind){
+    case ROADRUNNER: return f(KindTag<ROADRUNNER>{});
+    case COYOTE:     return f(KindTag<COYOTE>{});
+    default:         return f(KindTag<YOSEMITESAM>{});
+    }
+}
+template<class F> inline decltype(auto) with_policy(Policy p, F &&f){
+    if(p == Policy::FIELD) return f(FieldSteps{});
+    return f(GreedySteps{});
+}
+
+struct RaceResult {
+    int winner = -1;
+    int totalSteps = 0;
+    int jumps = 0, bursts = 0;           // Coyote jumps and RoadRunner bursts among the steps
+    int shots = 0, freezes = 0;          // YosemiteSam shots, and those that froze someone
+    long long ticks = 0;
+    long long sim_ms = 0;                // simulated race clock at the end
+};
+
+// One toon's dynamic state as a snapshot keeps it
+struct ToonState {
+    int16_t r, c;
+    uint8_t frozen, cooldown;
+    uint32_t thaw_at, ready_at;          // deadlines of the pending THAW / READY timers
+    uint32_t steps;
+};
+static_assert(std::is_trivially_copyable<ToonState>::value && sizeof(ToonState) == 20, "snapshots copy toons as flat arrays");
+
+// A headless race between two ticks: toon states, clock, result so far, the
+// event queue and the random streams. Timers are rebuilt from the toon states;
+// the static layer is not copied at all.
+struct RaceSnapshot {
+    long long now = 0;
+    RaceResult res;
+    std::vector<ToonState> toons;
+    std::vector<std::pair<long long, int>> due;
+    std::vector<std::mt19937> mt;
+    std::vector<FastRng> fast;
+};
+
+// Headless engine: every tick advances the race clock by delay_ms and gives each
+// toon one turn in index order. No threads, no sleeps, no locks; the outcome is a
+// pure function of the board and opt.seed.
+// --sched event: a tick jumps the clock to the next due action instead. Each toon
+// is a queue entry at the simulated ms of its next action, TOON_PERIOD_MS apart,
+// so speeds differ without any sleeping; a frozen toon's entry moves to its thaw.
+// Replay records are then stamped with the simulated ms.
+// --sched tiles: ticks as usual, but the toons take their turns tile by tile in
+// four colour phases (see tiles.hpp), each phase's tiles in parallel over the
+// race's lanes. Shots land after everyone has moved, in toon order, and a phase
+// that brings a toon home ends the tick with the lowest such toon as winner, so
+// the outcome does not depend on the number of lanes.
+class HeadlessRace {
+    using Due = std::pair<long long, int>;   // (ms, toon): ties go in toon order
+    const Options &opt;
+    Board &board;
+    long long tick_ms;
+    bool event;
+    bool tiled;                          // --sched tiles
+    std::vector<Due> due;                // min-heap on (ms, toon)
+    std::vector<int> ready;              // toons due at this tick
+    std::vector<int8_t> dr, dc;
+    std::vector<std::mt19937> mt;        // --rng mt
+    std::vector<FastRng> fast;           // --rng xoshiro
+    TimerWheel timers;
+    long long now = 0;
+    RaceResult res;
+    ReplayWriter *rec;                   // optional replay log
+    void (HeadlessRace::*play)();        // turns, events or tiles for this race's policy and rng
+    TileMap tileMap;                     // --sched tiles
+    std::vector<Lane> lanes;             // one per pool lane
+    std::vector<int> shots;              // the tick's shooters, merged from the lanes
+    std::unique_ptr<LanePool> pool;      // null: the tiles run on the caller
+
+    void rewind();                       // clock, result, timers and queue back to the start
+    long long stamp() const { return event ? now : res.ticks; }
+    void push_due(long long when, int t){ due.push_back({when, t}); std::push_heap(due.begin(), due.end(), std::greater<Due>()); }
+    template<class Rng> std::vector<Rng> &streams(){
+        if constexpr(std::is_same_v<Rng, FastRng>) return fast; else return mt;
+    }
+    // One turn of an unfrozen toon, specialized for its archetype K and the policy.
+    // Tiled turns may run on a lane thread: they leave steps, wins and shots in lane.
+    template<uint8_t K, class Steps, bool Tiled, class Rng> bool turn(int t, Rng &rng, ThreadStats &st, Lane &lane);
+    void shoot(int t, long long at, ThreadStats &st);
+    template<class Steps, class Rng> void turns();
+    template<class Steps, class Rng> void events();
+    template<class Steps, class Rng> void tiles();
+public:
+    // lanes: threads for --sched tiles, this one included (a recorded race uses one)
+    HeadlessRace(const Options &o, Board &b, ReplayWriter *log = nullptr, int lanes = 1);
+    // Start over on the same board, set up again for opt.seed (batch workers reuse
+    // one race and one board, so a race allocates nothing once they are warm)
+    void reset();
+    bool done() const {
+        return res.winner>=0 || res.ticks>=opt.maxSteps || res.totalSteps>=opt.maxSteps || gStop.load();
+    }
+    void tick();
+    RaceResult result() const { RaceResult r = res; r.sim_ms = now; return r; }
+
+    // Branching: snapshot() between ticks, restore() onto this race or another one
+    // whose board is a fork of the same layer, reseed() so branches diverge
+    RaceSnapshot snapshot() const;
+    void restore(const RaceSnapshot &s);
+    void reseed(unsigned seed);
+};
+
+// A single race to the end; --sched tiles spreads it over opt.jobs lanes
+RaceResult run_headless(const Options &opt, Board &board, ReplayWriter *log = nullptr);
+
+// --sched event or tiles with frames: the race, repainted after every tick and
+// paced so one simulated ms takes one wall-clock ms
+int run_event_view(const Options &opt, Board &board, ReplayWriter *log = nullptr);
+
+// Threaded engine: worker threads move the toons, a Renderer owns stdout
+int run_threaded(const Options &opt, Board &board, ReplayWriter *log = nullptr);
+
+void print_summary(const Board &b, int winner);
+
+// --stats: open cells and crowding of the set-up board, from the open bitboard
+void print_density(const Board &b);
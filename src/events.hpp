@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "mpsc_ring.hpp"
+
+// ---- Ability event bus (threaded --sync lock) ----
+// Workers do not touch the board's dynamic state. A turn publishes what its toon
+// means to do as typed intents on one bounded MPSC ring, and a single commit
+// stage pops them in ring order and applies them: collisions, jumps, bursts,
+// shots, freezes and the win are all decided there, so there is no lock on the
+// move path and two toons after one cell are settled by arrival order alone.
+// Whatever was applied goes to the subscribers (renderer, replay log, stats) on
+// the commit thread, so producers never wait on them.
+
+struct Intent {
+    enum Kind : uint8_t { STEP, JUMP, BURST, SHOOT };
+    Kind kind;
+    bool last;                           // the toon's last intent of its turn
+    int8_t dr, dc;                       // STEP: the step; JUMP: the hop (two cells)
+    int32_t toon;
+    uint64_t at = 0;                     // --trace: when the turn decided (trace.hpp), else 0
+};
+
+// What the commit stage did. Moves carry their cells; BLOCKED is a turn that
+// could not move at all; SHOT has target -1 if nobody was in range.
+struct Committed {
+    enum Kind : uint8_t { MOVE, JUMP, BURST, BLOCKED, SHOT, THAW, WIN };
+    Kind kind;
+    int32_t toon, target;
+    uint32_t from, to;
+    long long ms;
+    uint64_t decided = 0;                // --trace: the intent's decision time
+};
+
+template<size_t N> class EventBus {
+    MpscRing<Intent, N> ring;
+    std::vector<std::function<void(const Committed &)>> subs;
+    std::mutex wmtx;                     // only for waking a waiting commit stage
+    std::condition_variable wake;
+    std::atomic<bool> waiting{false};
+public:
+    // Any thread; spins (yielding) only while the ring is full. The fences pair
+    // with wait_for's, so either the publisher sees the waiter or the waiter
+    // sees the intent.
+    void publish(const Intent &i){
+        while(!ring.try_push(i)) std::this_thread::yield();
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(waiting.load(std::memory_order_relaxed)){ std::lock_guard<std::mutex> lk(wmtx); wake.notify_one(); }
+    }
+
+    // Commit side: blocks until something is published or d has passed
+    bool empty() const { return ring.empty(); }
+    template<class D> void wait_for(D d){
+        std::unique_lock<std::mutex> lk(wmtx);
+        waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(ring.empty()) wake.wait_for(lk, d);
+        waiting.store(false, std::memory_order_relaxed);
+    }
+
+    // Commit side: apply(i) for everything published so far; returns how many
+    template<class F> size_t drain(F &&apply){
+        size_t k = 0;
+        for(Intent i; ring.try_pop(i); k++) apply(i);
+        return k;
+    }
+    // Subscribe before the producers start; called on the commit thread, in order
+    void subscribe(std::function<void(const Committed &)> f){ subs.push_back(std::move(f)); }
+    void notify(const Committed &c) const { for(const auto &f : subs) f(c); }
+};
@@ -0,0 +1,141 @@
+#include "map.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+static const char MAP_MAGIC[8] = {'T','O','O','N','M','A','P','1'};
+
+MapFile::MapFile(const string &path, int toons) : file(path) {
+    if(!file.data()){ err = "cannot read map"; return; }
+    binary = file.size() >= sizeof(MapHeader) && memcmp(file.data(), MAP_MAGIC, sizeof MAP_MAGIC) == 0;
+    if(!(binary ? index_binary() : index_text())) return;
+    scan(toons);
+}
+
+// Row offsets from the line breaks; memchr does the searching
+bool MapFile::index_text(){
+    const char *base = (const char*)file.data(), *p = base, *end = base + file.size();
+    while(p < end){
+        const char *nl = (const char*)memchr(p, '\n', (size_t)(end - p));
+        const char *stop = nl ? nl : end;
+        size_t len = (size_t)(stop - p);
+        if(len && p[len-1] == '\r') len--;
+        if(rowAt.empty()){
+            if(len < 3 || len > INT16_MAX) return fail("rows must be 3 to 32767 cells wide");
+            C = (int)len;
+        }
+        if(len != (size_t)C) return fail("row " + to_string(rowAt.size()) + " has " + to_string(len) + " cells, expected " + to_string(C));
+        rowAt.push_back((size_t)(p - base));
+        if(rowAt.size() > INT16_MAX) return fail("too many rows");
+        p = nl ? nl + 1 : end;
+    }
+    R = (int)rowAt.size();
+    return R ? true : fail("empty map");
+}
+
+bool MapFile::index_binary(){
+    MapHeader h;
+    memcpy(&h, file.data(), sizeof h);
+    if(h.rows < 1 || h.rows > INT16_MAX || h.cols < 3 || h.cols > INT16_MAX) return fail("bad board size");
+    R = (int)h.rows; C = (int)h.cols;
+    const size_t cells = (size_t)R*C;
+    if(file.size() < sizeof h + cells + (size_t)h.starts*sizeof(uint32_t)) return fail("truncated map");
+    rowAt.resize(R);
+    for(int r=0;r<R;r++) rowAt[r] = sizeof h + (size_t)r*C;
+    starts.resize(h.starts);
+    if(h.starts) memcpy(starts.data(), file.data() + sizeof h + cells, h.starts*sizeof(uint32_t));
+    for(uint32_t s : starts) if(s >= cells) return fail("bad start cell");
+    return true;
+}
+
+// All eight bytes at p are '.' or '#' (SWAR: a byte is plain when it XORs to
+// zero against either glyph), so the common run of floor and walls skips ahead
+static bool plain8(const unsigned char *p){
+    uint64_t w; memcpy(&w, p, 8);
+    const uint64_t lo7 = 0x7f7f7f7f7f7f7f7full;
+    auto nonzero = [&](uint64_t v){ return ((v & lo7) + lo7) | v; };   // high bit set per non-zero byte
+    return (nonzero(w ^ 0x2e2e2e2e2e2e2e2eull) & nonzero(w ^ 0x2323232323232323ull) & ~lo7) == 0;
+}
+
+// One pass over every cell: rejects unknown glyphs, finds the flag, the finish
+// line and the text starts, then checks that the toons fit
+bool MapFile::scan(int toons){
+    const unsigned char *base = file.data();
+    auto bad = [&](int r, int c){ return fail(string("bad cell '") + (char)base[rowAt[r] + c] + "' at row " + to_string(r) + ", column " + to_string(c)); };
+    bool hasFlag = false;
+    finishCol = C-1;
+    for(int r=0;r<R;r++){
+        const unsigned char *p = base + rowAt[r];
+        for(int c=0;c<C;c++){
+            if(c + 8 <= C && plain8(p + c)){ c += 7; continue; }
+            switch(p[c]){
+            case '.': case '#': break;
+            case '|': finishCol = min(finishCol, c); break;
+            case 'F':
+                if(hasFlag) return fail("more than one flag");
+                flag = {r,c}; hasFlag = true;
+                break;
+            case 'S':
+                if(binary) return bad(r,c);       // binary starts are listed after the cells
+                starts.push_back((uint32_t)(r*C + c));
+                break;
+            default: return bad(r,c);
+            }
+        }
+    }
+    if(finishCol < 2) return fail("finish line leaves no room to start");
+    if(!hasFlag) flag = {R/2, finishCol-1};
+
+    auto open = [&](uint32_t s){
+        int r = (int)(s / C), c = (int)(s % C);
+        unsigned char ch = base[rowAt[r] + c];
+        return (ch == '.' || ch == 'S') && !(r == flag.r && c == flag.c);
+    };
+    vector<uint32_t> seen(starts);
+    sort(seen.begin(), seen.end());
+    if(adjacent_find(seen.begin(), seen.end()) != seen.end()) return fail("two starts on one cell");
+    for(uint32_t s : starts){
+        if(!open(s)) return fail("start on a wall or the flag");
+        if((int)(s % C) > finishCol-2) return fail("start on or past the finish line");
+    }
+
+    // Toons without a start cell draw one left of the goal column
+    const size_t used = min(starts.size(), (size_t)max(toons, 0));
+    if(used == (size_t)toons) return true;
+    size_t free = 0;
+    for(int r=0;r<R;r++){
+        const unsigned char *p = base + rowAt[r];
+        free += (size_t)(count(p, p + finishCol-1, '.') + count(p, p + finishCol-1, 'S'));
+    }
+    for(size_t i=0;i<used;i++) if((int)(starts[i] % C) < finishCol-1) free--;
+    if(free < (size_t)toons - used) return fail("not enough open cells for " + to_string(toons) + " toons");
+    return true;
+}
+
+void MapFile::load(Board &b, const Options &opt) const {
+    for(int r=0;r<R;r++) memcpy(b.edit_row(r), file.data() + rowAt[r], C);
+    for(uint32_t s : starts) b.edit((int)(s / C), (int)(s % C)) = '.';
+    b.finishCol = finishCol;
+    b.flag = flag;
+    b.edit(flag.r, flag.c) = 'F';
+    b.pack_open();
+    const int used = (int)min(starts.size(), (size_t)b.n);
+    for(int t=0;t<used;t++) place_toon(b, t, {(int)(starts[t] / C), (int)(starts[t] % C)});
+    if(used < b.n){ mt19937 rng(opt.seed); random_starts(b, rng, used); }
+    if(opt.policy == Policy::FIELD) build_distance_field(b);
+}
+
+bool save_map(const Board &b, const string &path){
+    FILE *f = fopen(path.c_str(), "wb");
+    if(!f) return false;
+    MapHeader h{};
+    memcpy(h.magic, MAP_MAGIC, sizeof h.magic);
+    h.rows = (uint32_t)b.R; h.cols = (uint32_t)b.C; h.starts = (uint32_t)b.n;
+    fwrite(&h, sizeof h, 1, f);
+    for(int r=0;r<b.R;r++) fwrite(b.row(r), 1, b.C, f);
+    for(int t=0;t<b.n;t++){ uint32_t c = (uint32_t)(b.tr[t]*b.C + b.tc[t]); fwrite(&c, sizeof c, 1, f); }
+    return fclose(f) == 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "board.hpp"
+#include "mapped_file.hpp"
+#include "options.hpp"
+
+// ---- Board maps (--map, --save-map) ----
+// Text: one line per row, every row the same width ('\n' or "\r\n" endings):
+//   '.' floor   '#' wall   '|' finish line   'F' flag   'S' start (floor)
+// The goal is the column in front of the leftmost '|' (the last column when
+// there is none), and the flag defaults to the middle of that column.
+// Binary: MapHeader, the R*C static cells row-major, then the start cell of
+// each toon (uint32, r*C+c) -- the same layout as the head of a replay log.
+// Either way the file is memory-mapped, checked once, and load() copies the
+// rows straight into Board::cell; nothing is parsed per race.
+
+struct MapHeader {
+    char magic[8];                       // "TOONMAP1"
+    uint32_t rows, cols, starts;
+    uint32_t reserved;
+};
+
+class MapFile {
+    MappedFile file;
+    int R = 0, C = 0;
+    std::vector<size_t> rowAt;           // file offset of each row
+    std::vector<uint32_t> starts;        // start cells in file order (text: row-major)
+    Pos flag{0,0};
+    int finishCol = 0;
+    bool binary = false;
+    std::string err;
+
+    bool fail(const std::string &why){ err = why; return false; }
+    bool index_text();
+    bool index_binary();
+    bool scan(int toons);
+public:
+    // Maps and checks the file for a race of toons toons; check ok() afterwards
+    MapFile(const std::string &path, int toons);
+    bool ok() const { return err.empty(); }
+    const std::string &error() const { return err; }
+    int rows() const { return R; }
+    int cols() const { return C; }
+
+    // Static cells, flag, finish line and starts onto a fresh Board(rows(), cols(), toons).
+    // Toons past the map's starts get random cells drawn from opt.seed.
+    void load(Board &b, const Options &opt) const;
+};
+
+// Writes the set-up board (cells and current toon cells) as a binary map
+bool save_map(const Board &b, const std::string &path);
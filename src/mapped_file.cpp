@@ -0,0 +1,37 @@
+#include "mapped_file.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+using namespace std;
+
+MappedFile::MappedFile(const string &path){
+#ifndef _WIN32
+    map = MAP_FAILED;
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) return;
+    struct stat st;
+    if(fstat(fd, &st) == 0 && st.st_size > 0){
+        map = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map != MAP_FAILED){ p = (const unsigned char*)map; n = (size_t)st.st_size; }
+    }
+    close(fd);
+#else
+    ifstream in(path, ios::binary);
+    copy.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    if(!copy.empty()){ p = copy.data(); n = copy.size(); }
+#endif
+}
+
+MappedFile::~MappedFile(){
+#ifndef _WIN32
+    if(map != MAP_FAILED) munmap(map, n);
+#endif
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Read-only view of a whole file: mmap where available, a heap copy elsewhere.
+// data() is null if the file could not be read or is empty.
+class MappedFile {
+    const unsigned char *p = nullptr;
+    size_t n = 0;
+#ifndef _WIN32
+    void *map;
+#else
+    std::vector<unsigned char> copy;
+#endif
+public:
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    const unsigned char *data() const { return p; }
+    size_t size() const { return n; }
+};
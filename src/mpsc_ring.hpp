@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Bounded lock-free multi-producer / single-consumer ring (Vyukov). Each slot
+// carries a sequence number telling producers and the consumer whether it is
+// free or full; producers race only on one CAS of the tail, the consumer never
+// synchronizes with anybody except through the slot it reads.
+template<class T, size_t N>
+class MpscRing {
+    static_assert((N & (N-1)) == 0, "capacity must be a power of two");
+    struct Slot { std::atomic<size_t> seq; T val; };
+    std::unique_ptr<Slot[]> slots;
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) size_t head = 0;
+public:
+    MpscRing() : slots(new Slot[N]) { for(size_t i=0;i<N;i++) slots[i].seq.store(i, std::memory_order_relaxed); }
+
+    bool try_push(const T &v){
+        size_t pos = tail.load(std::memory_order_relaxed);
+        for(;;){
+            Slot &s = slots[pos & (N-1)];
+            intptr_t diff = (intptr_t)s.seq.load(std::memory_order_acquire) - (intptr_t)pos;
+            if(diff == 0){
+                if(tail.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)){
+                    s.val = v; s.seq.store(pos+1, std::memory_order_release); return true;
+                }
+            } else if(diff < 0) return false;            // full
+            else pos = tail.load(std::memory_order_relaxed);
+        }
+    }
+    bool try_pop(T &out){
+        Slot &s = slots[head & (N-1)];
+        if(s.seq.load(std::memory_order_acquire) != head+1) return false;
+        out = s.val; s.seq.store(head+N, std::memory_order_release); head++;
+        return true;
+    }
+    // Consumer side: nothing to pop right now
+    bool empty() const { return slots[head & (N-1)].seq.load(std::memory_order_acquire) != head+1; }
+};
@@ -0,0 +1,146 @@
+#include "options.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+Options parseArgs(int argc, char** argv){
+    Options o;
+    auto takeInt = [&](int &out, int i, char** argv){ out = stoi(argv[i]); };
+    for(int i=1;i<argc;i++){
+        string a = argv[i];
+        auto next = [&](int &slot){ if(i+1<argc) takeInt(slot, ++i, argv); };
+        if(a=="--rows") next(o.rows);
+        else if(a=="--cols") next(o.cols);
+        else if(a=="--toons") next(o.toons);
+        else if(a=="--max-steps") next(o.maxSteps);
+        else if(a=="--seed") { if(i+1<argc) o.seed = (unsigned)stoul(argv[++i]); }
+        else if(a=="--delay-ms") next(o.delay_ms);
+        else if(a=="--shoot-chance") { if(i+1<argc) o.sam_shoot_chance = stod(argv[++i]); }
+        else if(a=="--shoot-cooldown") next(o.sam_cooldown_ms);
+        else if(a=="--freeze-ms") next(o.sam_freeze_ms);
+        else if(a=="--jump-chance") { if(i+1<argc) o.coy_jump_chance = stod(argv[++i]); }
+        else if(a=="--headless") o.headless = true;
+        else if(a=="--live") o.stacked = false;
+        else if(a=="--frames") { if(i+1<argc) set_option(o, "frames", argv[++i]); }
+        else if(a=="--races") next(o.races);
+        else if(a=="--jobs") next(o.jobs);
+        else if(a=="--fork-at") next(o.forkAt);
+        else if(a=="--branches") next(o.branches);
+        else if(a=="--sweep") { if(i+1<argc) o.sweep = argv[++i]; }
+        else if(a=="--serve") { if(i+1<argc) o.serve = argv[++i]; }
+        else if(a=="--sync") { if(i+1<argc) o.sync = string(argv[++i])=="cas" ? Sync::CAS : Sync::LOCK; }
+        else if(a=="--sched") { if(i+1<argc && !set_option(o, "sched", argv[++i])) o.sched = Sched::TICK; }
+        else if(a=="--rng") { if(i+1<argc) o.rng = string(argv[++i])=="xoshiro" ? RngKind::XOSHIRO : RngKind::MT; }
+        else if(a=="--record") { if(i+1<argc) o.record = argv[++i]; }
+        else if(a=="--replay") { if(i+1<argc) o.replay = argv[++i]; }
+        else if(a=="--frame") { if(i+1<argc) o.frame = stoll(argv[++i]); }
+        else if(a=="--stats") { o.stats = true; }
+        else if(a=="--stats-json") { if(i+1<argc) o.statsJson = argv[++i]; }
+        else if(a=="--trace") { if(i+1<argc) o.trace = argv[++i]; }
+        else if(a=="--results") { if(i+1<argc) o.results = argv[++i]; }
+        else if(a=="--map") { if(i+1<argc) o.map = argv[++i]; }
+        else if(a=="--save-map") { if(i+1<argc) o.saveMap = argv[++i]; }
+        else if(a=="--policy") { if(i+1<argc) o.policy = string(argv[++i])=="field" ? Policy::FIELD : Policy::GREEDY; }
+        else if(a=="--help"){
+            cout << "Options\n"
+                 << "  --rows N             (default 18)\n"
+                 << "  --cols N             (default 36)\n"
+                 << "  --toons N            (default 3: R,C,Y; more repeat the three)\n"
+                 << "  --max-steps N        (default 10000)\n"
+                 << "  --seed N             (default time)\n"
+                 << "  --delay-ms N         (default 120)\n"
+                 << "  --live               (redraw in place, only changed cells)\n"
+                 << "  --frames F           (all | every:N | fps:F | events | final, default all)\n"
+                 << "  --shoot-chance X     (default 0.15)\n"
+                 << "  --shoot-cooldown N   (ms, default 1500)\n"
+                 << "  --freeze-ms N        (default 1000)\n"
+                 << "  --jump-chance X      (default 0.25)\n"
+                 << "  --headless           (deterministic tick loop, no frames)\n"
+                 << "  --races N            (batch of N headless races, default 0)\n"
+                 << "  --jobs N             (batch worker threads, tiles lanes, default all cores)\n"
+                 << "  --fork-at T          (with --branches: tick to snapshot the race at, default 0)\n"
+                 << "  --branches N         (finish the race N times from --fork-at on fresh streams)\n"
+                 << "  --sweep SPEC         (CSV of every combination, e.g. \"shoot-chance=0.1,0.3;rows=18,40\";\n"
+                 << "                        --races per combination, default 100)\n"
+                 << "  --serve SRC          (race server: specs from stdin (-) or loopback TCP port SRC)\n"
+                 << "  --policy P           (greedy | field: follow the distance field, default greedy)\n"
+                 << "  --sync S             (lock | cas: lock-free moves on the occupancy grid, default lock)\n"
+                 << "  --sched S            (tick | event: simulated-time action queue, no sleeps |\n"
+                 << "                        tiles: ticks run tile by tile over --jobs threads, default tick)\n"
+                 << "  --rng R              (mt | xoshiro: block-filled xoshiro256** streams, default mt)\n"
+                 << "  --record FILE        (write a binary replay log of the race)\n"
+                 << "  --replay FILE        (play a replay log back instead of racing)\n"
+                 << "  --frame K            (with --replay: print only the board at tick/ms K)\n"
+                 << "  --stats              (print counters and phase timings after the run)\n"
+                 << "  --stats-json FILE    (write the same numbers as JSON)\n"
+                 << "  --trace FILE         (threaded races: Chrome trace JSON of every move, and latency percentiles)\n"
+                 << "  --results FILE       (append per-race results of headless runs, for toons_agg)\n"
+                 << "  --map FILE           (board from a text or binary map; sets rows and cols)\n"
+                 << "  --save-map FILE      (write the set-up board as a binary map)\n";
+            exit(0);
+        }
+    }
+    clamp_options(o);
+    return o;
+}
+
+void clamp_options(Options &o){
+    o.rows = min(max(5, o.rows), INT16_MAX);
+    o.cols = min(max(20, o.cols), INT16_MAX);
+    // Leave room for walls and moves. A map's size is only known once it is
+    // read, and MapFile rejects more toons than it has open cells for.
+    o.toons = max(1, o.map.empty() ? min(o.toons, o.rows*(o.cols-2)/2) : o.toons);
+    o.maxSteps = max(100, o.maxSteps);
+    o.races = max(0, o.races);
+    o.jobs = max(1, o.jobs);
+    if(o.frames == Frames::EVERY) o.frameArg = max(1.0, floor(o.frameArg));
+    if(o.frames == Frames::FPS && !(o.frameArg > 0)) o.frames = Frames::ALL;
+}
+
+bool set_option(Options &o, const string &name, const string &value){
+    const char *v = value.c_str();
+    char *end = nullptr;
+    auto whole = [&]{ return !value.empty() && *end == '\0'; };
+    auto toInt = [&](int &out){ long x = strtol(v, &end, 10); if(!whole() || x < INT32_MIN || x > INT32_MAX) return false; out = (int)x; return true; };
+    auto toReal = [&](double &out){ double x = strtod(v, &end); if(!whole()) return false; out = x; return true; };
+    if(name=="rows") return toInt(o.rows);
+    if(name=="cols") return toInt(o.cols);
+    if(name=="toons") return toInt(o.toons);
+    if(name=="max-steps") return toInt(o.maxSteps);
+    if(name=="delay-ms") return toInt(o.delay_ms);
+    if(name=="shoot-cooldown") return toInt(o.sam_cooldown_ms);
+    if(name=="freeze-ms") return toInt(o.sam_freeze_ms);
+    if(name=="shoot-chance") return toReal(o.sam_shoot_chance);
+    if(name=="jump-chance") return toReal(o.coy_jump_chance);
+    if(name=="seed"){ unsigned long long x = strtoull(v, &end, 10); if(!whole() || x > UINT32_MAX) return false; o.seed = (unsigned)x; return true; }
+    if(name=="policy"){ if(value!="greedy" && value!="field") return false; o.policy = value=="field" ? Policy::FIELD : Policy::GREEDY; return true; }
+    if(name=="rng"){ if(value!="mt" && value!="xoshiro") return false; o.rng = value=="xoshiro" ? RngKind::XOSHIRO : RngKind::MT; return true; }
+    if(name=="sched"){
+        if(value=="tick") o.sched = Sched::TICK;
+        else if(value=="event") o.sched = Sched::EVENT;
+        else if(value=="tiles") o.sched = Sched::TILES;
+        else return false;
+        return true;
+    }
+    if(name=="frames"){
+        const size_t colon = value.find(':');
+        const string mode = value.substr(0, colon);
+        double arg = 0;
+        if(colon != string::npos){ const char *n = v + colon + 1; arg = strtod(n, &end); if(end == n || *end) return false; }
+        if(mode=="all") o.frames = Frames::ALL;
+        else if(mode=="events") o.frames = Frames::EVENTS;
+        else if(mode=="final") o.frames = Frames::FINAL;
+        else if(mode=="every" && colon != string::npos) o.frames = Frames::EVERY;
+        else if(mode=="fps" && colon != string::npos) o.frames = Frames::FPS;
+        else return false;
+        o.frameArg = arg;
+        return true;
+    }
+    if(name=="map"){ if(value.empty()) return false; o.map = value; return true; }
+    return false;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <thread>
+
+// How a toon picks its step: sign of (flag - pos), or descend the BFS distance field
+enum class Policy : uint8_t { GREEDY, FIELD };
+
+// Threaded mode: every move under board.mtx, or per-cell CAS on the occupancy grid
+enum class Sync : uint8_t { LOCK, CAS };
+
+// Headless clock: fixed ticks of delay_ms, jump to the next due toon action, or
+// fixed ticks with the turns run tile by tile in parallel
+enum class Sched : uint8_t { TICK, EVENT, TILES };
+
+// Which frames the stacked/live views print: all, every Nth, at most F per second of
+// race time, only the event lines, or only the final board
+enum class Frames : uint8_t { ALL, EVERY, FPS, EVENTS, FINAL };
+
+// Per-toon random streams: mt19937 or block-filled xoshiro256** (see rng.hpp)
+enum class RngKind : uint8_t { MT, XOSHIRO };
+
+struct Options {
+    int rows = 18;
+    int cols = 36;            // close to your sample width
+    int toons = 3;            // R (RoadRunner), C (Coyote), Y (YosemiteSam), then repeating
+    int maxSteps = 10000;
+    unsigned int seed = std::random_device{}();
+
+    // Output pacing & stacked style
+    bool stacked = true;      // print NEW board for each update (matches your sample); false = --live
+    int delay_ms = 120;       // wait between printed boards (enhances realism)
+    Frames frames = Frames::ALL;
+    double frameArg = 0;      // N for EVERY, F for FPS
+    bool headless = false;    // single-threaded tick loop, no sleeps, no frames
+    Policy policy = Policy::GREEDY;
+    Sync sync = Sync::LOCK;
+    RngKind rng = RngKind::MT;
+    Sched sched = Sched::TICK;
+
+    // Replay log: record a single race, or play one back (--frame: just that frame)
+    std::string record;
+    std::string replay;
+    long long frame = -1;
+
+    // Run counters and phase timings, printed after the summary and/or as JSON
+    bool stats = false;
+    std::string statsJson;
+
+    // Per-move trace of a threaded race as Chrome trace JSON, plus latency histograms
+    std::string trace;
+
+    // Columnar per-race results of headless runs, appended to FILE (see results.hpp)
+    std::string results;
+
+    // Board layout from a text or binary map (rows/cols come from the file), and
+    // the set-up board written back out as a binary map
+    std::string map;
+    std::string saveMap;
+
+    // What-if branching: run to tick forkAt, then finish the race branches times
+    int forkAt = 0;
+    int branches = 0;
+
+    // Parameter sweep: every combination of the SPEC's values, races races each
+    std::string sweep;
+
+    // Race server: specs from stdin ("-") or a loopback TCP port, results streamed back
+    std::string serve;
+
+    // Batch Monte Carlo (implies headless)
+    int races = 0;            // 0 = single race
+    int jobs = (int)std::max(1u, std::thread::hardware_concurrency());
+
+    // Ability tuning
+    double rr_burst_chance = 0.15;     // RoadRunner burst (extra step)
+    double coy_jump_chance = 0.25;     // Coyote jump when blocked
+    double sam_shoot_chance = 0.15;    // YosemiteSam may shoot
+    int    sam_cooldown_ms = 1500;     // cooldown between shots
+    int    sam_freeze_ms   = 1000;     // freeze duration
+};
+
+Options parseArgs(int argc, char** argv);
+
+// The range checks parseArgs applies, for options set some other way (--sweep, --serve)
+void clamp_options(Options &o);
+
+// Sets one race option by its flag name without the dashes ("rows", "shoot-chance",
+// "policy", "map", ...) from text; false if the name is not a race option or the
+// value does not parse. Does not clamp.
+bool set_option(Options &o, const std::string &name, const std::string &value);
@@ -0,0 +1,238 @@
+#include "render.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "stats.hpp"
+#include "trace.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+static void write_all(const char *p, size_t n){
+#ifdef _WIN32
+    fwrite(p, 1, n, stdout); fflush(stdout);
+#else
+    while(n){
+        ssize_t k = ::write(STDOUT_FILENO, p, n);
+        if(k < 0){ if(errno==EINTR) continue; return; }
+        p += k; n -= (size_t)k;
+    }
+#endif
+}
+
+void write_out(const char *p, size_t n){
+    const uint64_t t0 = trace_mark();
+    write_all(p, n);
+    if(t0){
+        const uint64_t t1 = trace_now();
+        TraceBuf &tb = trace_local();
+        tb.add({t0, t1, 0, (int32_t)min<size_t>(n, INT32_MAX), TR_WRITE});
+        tb.hist[L_WRITE].add(t1 - t0);
+    }
+}
+
+static inline void append_int(string &f, long long v){
+    char num[24]; f.append(num, to_chars(num, num+sizeof num, v).ptr);
+}
+
+void build_frame(Screen &b, int totalSteps){
+    string &f = b.frame;
+    size_t at = f.size();
+    f.resize(at + (size_t)(b.C+3)*(b.R+2));            // '|' + cells + '|' + '\n' per line
+    char *p = &f[at];
+    auto border = [&]{ *p++='+'; memset(p, '-', b.C); p += b.C; *p++='+'; *p++='\n'; };
+    border();
+    for(int r=0;r<b.R;r++){ *p++='|'; memcpy(p, &b.px(r,0), b.C); p += b.C; *p++='|'; *p++='\n'; }
+    border();
+    f.append("steps: "); append_int(f, totalSteps);
+    f.append("\n\n");  // extra blank line between boards
+}
+
+// ---- Live (in-place) output ----
+// Screen rows: 1 top border, 2..R+1 board, R+2 bottom border, R+3 steps, R+5 events.
+
+static inline void append_cup(string &f, int row, int col){   // cursor to (row, col), 1-based
+    f.append("\x1b["); append_int(f, row); f += ';'; append_int(f, col); f += 'H';
+}
+
+// A move costs a few dozen bytes instead of R*C.
+static void print_live(Screen &b, int totalSteps){
+    string &f = b.frame;
+    f.clear();
+    if(!b.shown){
+        f.append("\x1b[?25l\x1b[H\x1b[2J");          // hide cursor, home, clear
+        build_frame(b, totalSteps);
+        b.shown = true;
+    } else {
+        long last = -2;
+        for(uint32_t i : b.dirty){
+            if((long)i == last) continue;                    // same cell patched twice (stay step)
+            int r = (int)(i / b.C), c = (int)(i % b.C);
+            if((long)i != last+1 || c == 0) append_cup(f, r+2, c+2);   // the cursor already advanced
+            f += b.grid[i];
+            last = i;
+        }
+        append_cup(f, b.R+3, 1);
+        f.append("steps: "); append_int(f, totalSteps); f.append("\x1b[K");
+    }
+    write_out(f.data(), f.size());
+    b.dirty.clear();
+}
+
+void print_board(Screen &b, int totalSteps){
+    PhaseTimer pt(RENDER);
+    if(b.live){ print_live(b, totalSteps); return; }
+    b.frame.clear();
+    build_frame(b, totalSteps);
+    write_out(b.frame.data(), b.frame.size());
+    b.dirty.clear();
+}
+
+void print_event(Screen &b, const string &msg){
+    PhaseTimer pt(RENDER);
+    string &f = b.frame;                             // composed in the frame buffer, no temporaries
+    f.clear();
+    if(b.live){ append_cup(f, b.R+5, 1); f += msg; f.append("\x1b[K"); }
+    else { f += msg; f.append("\n\n"); }           // small text + space after
+    write_out(f.data(), f.size());
+}
+
+void end_live(Screen &b){
+    if(!b.live) return;
+    string f; append_cup(f, b.R+6, 1); f.append("\x1b[?25h");
+    write_out(f.data(), f.size());
+}
+
+void skip_frame(Screen &b){
+    if(!b.live || b.dirty.size() > b.grid.size()){ b.dirty.clear(); b.shown = false; }
+}
+
+// ---- Renderer ----
+
+Renderer::Renderer(Board &board, const Options &opt, int steps)
+  : b(board), view(board.scr), gate(opt), t0(steady_clock::now()), delay_ms(opt.delay_ms),
+    concurrent(opt.sync == Sync::CAS), pub_steps(steps) {
+    view.steps_hint = steps;
+    board.scr.dirty.clear();
+    if(gate.boards()) print_board(view, steps);      // first frame
+    th = thread(&Renderer::loop, this);
+}
+
+void Renderer::snapshot(){
+    TraceScope span(TR_RESYNC);
+    if(concurrent){
+        snap_seq = pub_seq.load();
+        for(int r=0;r<b.R;r++) for(int c=0;c<b.C;c++){
+            int k = b.occupant(b.idx(r,c));
+            view.px(r,c) = k >= 0 ? toon_glyph(b,k) : b.at(r,c);
+        }
+        view.steps_hint += dropped.exchange(0);
+        view.dirty.clear();
+        view.shown = false;
+        return;
+    }
+    lock_guard<mutex> lk(b.mtx);
+    view.grid = b.scr.grid;
+    snap_seq = pub_seq;
+    view.steps_hint = pub_steps;
+    view.dirty.clear();
+    view.shown = false;                              // live: repaint in full
+}
+
+// toon_name without the temporary string
+static void append_name(string &f, const Board &b, int t){
+    f += TOON_NM[b.n <= NKINDS ? t : b.kind[t]];
+    if(b.n > NKINDS){ f += '#'; append_int(f, t); }
+}
+
+void Renderer::event_text(const RenderMsg &m){
+    string &s = line;
+    s.assign("[Update] "); append_name(s, b, m.toon);
+    if(m.kind == RenderMsg::Jump){
+        s.append(" jumps to ("); append_int(s, m.cell / b.C); s += ','; append_int(s, m.cell % b.C); s += ')';
+    } else {
+        s.append(" shoots "); append_name(s, b, m.target);
+        s.append(" — frozen for "); append_int(s, m.value); s.append(" ms");
+    }
+    print_event(view, s);
+}
+
+// Prints the view, then closes every traced move it is the first frame to show
+void Renderer::print(){
+    { TraceScope span(TR_FRAME, view.steps_hint); print_board(view, view.steps_hint); }
+    if(moving.empty()) return;
+    const uint64_t shown = trace_now();
+    TraceBuf &tb = trace_local();
+    for(TraceEvent &e : moving){
+        e.end = shown;
+        tb.add(e);
+        tb.hist[L_COMMIT_FRAME].add(shown - e.mid);
+        tb.hist[L_DECIDE_FRAME].add(shown - e.ts);
+    }
+    moving.clear();
+}
+
+// A Frame or Move: where a board is due. --frames all coalesces them until the
+// queue drains; the other modes decide per frame and never leave one pending.
+void Renderer::made_frame(bool &pending){
+    if(gate.all()){ pending = true; return; }
+    const long long ms = duration_cast<milliseconds>(steady_clock::now() - t0).count();
+    if(gate.take(++frames, ms)) print();
+    else skip_frame(view);
+}
+
+void Renderer::loop(){
+    trace_thread("renderer");
+    bool pending = false;
+    RenderMsg m;
+    for(;;){
+        if(resync.exchange(false, memory_order_relaxed)){ snapshot(); pending = gate.all(); }
+        if(!q.try_pop(m)){
+            if(pending){ print(); pending = false; continue; }
+            if(done.load(memory_order_acquire)){ if(!q.try_pop(m)) return; }
+            else { this_thread::sleep_for(milliseconds(1)); continue; }
+        }
+        switch(m.kind){
+        case RenderMsg::Cell:
+            if(m.seq > snap_seq){ view.grid[m.cell] = m.glyph; view.dirty.push_back(m.cell); }
+            break;
+        case RenderMsg::Frame:
+            if(m.seq > snap_seq) view.steps_hint = m.value;
+            if(m.decided) moving.push_back({m.decided, 0, m.committed, m.toon, TR_MOVE});
+            made_frame(pending);
+            break;
+        case RenderMsg::Move:
+            if(m.seq > snap_seq){
+                view.grid[m.target] = (char)m.value; view.dirty.push_back((uint32_t)m.target);
+                view.grid[m.cell] = m.glyph; view.dirty.push_back(m.cell);
+            }
+            view.steps_hint++;
+            if(m.decided) moving.push_back({m.decided, 0, m.committed, m.toon, TR_MOVE});
+            made_frame(pending);
+            break;
+        default:
+            if(pending){ print(); pending = false; }
+            if(!gate.events()) break;
+            event_text(m);
+            if(gate.all()){ TraceScope span(TR_PAUSE); this_thread::sleep_for(milliseconds(delay_ms)); } // respect pacing when logging
+        }
+    }
+}
+
+void Renderer::finish(int steps){
+    done.store(true, memory_order_release);
+    th.join();
+    if(resync.exchange(false)) snapshot();
+    view.steps_hint = steps;
+    print();
+    end_live(view);
+}
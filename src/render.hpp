@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "board.hpp"
+#include "mpsc_ring.hpp"
+#include "options.hpp"
+#include "trace.hpp"
+
+// All frame/event output goes straight to fd 1 in one call per frame, bypassing
+// cout so nothing is split across a per-char stream.
+void write_out(const char *p, size_t n);
+
+// Appends borders, rows and the steps line to b.frame; its capacity is reused
+void build_frame(Screen &b, int totalSteps);
+
+// Stacked: one full frame. Live: first call draws the whole frame, later calls
+// only rewrite the dirty cells and the steps line.
+void print_board(Screen &b, int totalSteps);
+
+// Event feed: stacked mode prints the line between frames, live mode keeps a
+// single status line under the board.
+void print_event(Screen &b, const std::string &msg);
+
+// Leave the cursor below the live board so the summary prints after it
+void end_live(Screen &b);
+
+// A frame that was not printed: forget its patches (stacked frames are drawn
+// from the grid anyway), or, live, keep them for the next frame unless there
+// are more than cells, when a full repaint is cheaper
+void skip_frame(Screen &b);
+
+// --frames: which frames get printed. Frames are numbered 1, 2, ... in the
+// order a view makes them and stamped with race time in ms; a skipped frame
+// costs nothing but skip_frame, and the steps shown are exact whenever one is
+// printed. Only --frames all pauses for the terminal (delay-ms after events
+// and replay ticks, event-view sleeps); the final board is always printed.
+class FrameGate {
+    Frames mode;
+    long long every;
+    double gap_ms, next_ms = 0;
+public:
+    explicit FrameGate(const Options &o)
+      : mode(o.frames), every(mode == Frames::EVERY ? (long long)o.frameArg : 1), gap_ms(mode == Frames::FPS ? 1000.0 / o.frameArg : 0) {}
+    bool all() const { return mode == Frames::ALL; }
+    bool boards() const { return mode != Frames::EVENTS && mode != Frames::FINAL; }   // any before the last
+    bool events() const { return mode != Frames::FINAL; }
+    bool take(long long n, long long ms){
+        switch(mode){
+        case Frames::ALL:   return true;
+        case Frames::EVERY: return n % every == 0;
+        case Frames::FPS:   if(ms < next_ms) return false; next_ms = ms + gap_ms; return true;
+        default:            return false;
+        }
+    }
+};
+
+// ---- Renderer thread ----
+
+// One queued update. Cell carries the new glyph so the renderer never reads the
+// board; Frame marks a point where the old code printed a board. Move is the
+// --sync cas form of one step: both cells, one more step and a frame.
+struct RenderMsg {
+    enum Kind : uint8_t { Cell, Frame, Move, Jump, Shot } kind;
+    int32_t toon = 0, target = 0;        // Move: target is the cell left
+    char glyph = 0;
+    uint32_t cell = 0;                   // Cell: r*C+c; Move, Jump: destination
+    int32_t value = 0;                   // Frame: steps; Move: ground char of the cell left; Shot: freeze ms
+    uint64_t seq = 0;                    // publish order
+    uint64_t decided = 0, committed = 0; // --trace, Frame and Move: the move's decision and commit times
+};
+
+// Owns stdout while the threaded race runs. The commit stage publishes under
+// board.mtx (which fixes the order) and never waits for the terminal. When the renderer
+// falls behind it applies every queued cell but prints only the newest frame;
+// if the ring overflows, producers drop and flag a resync, and the renderer
+// copies the model grid once under board.mtx and discards the stale cells.
+// With --sync cas there is no model grid and no lock: workers push from any
+// thread and a resync redraws from occ, which is only as exact as a glance.
+class Renderer {
+    static constexpr size_t QCAP = 1 << 14;
+    Board &b;
+    Screen view;
+    MpscRing<RenderMsg, QCAP> q;
+    FrameGate gate;                      // renderer side
+    long long frames = 0;                // renderer side: frames made so far
+    std::chrono::steady_clock::time_point t0;
+    int delay_ms;
+    bool concurrent;                     // --sync cas
+    std::atomic<uint64_t> pub_seq{0};    // lock mode: only bumped by the commit stage
+    int pub_steps = 0;                   // guarded by board.mtx
+    std::atomic<int> dropped{0};         // cas: steps whose Move was lost to overflow
+    std::atomic<bool> resync{false}, done{false};
+    uint64_t snap_seq = 0;               // renderer side: cells at or before this are stale
+    std::string line;                    // renderer side: event text, capacity reused
+    std::vector<TraceEvent> moving;      // renderer side, --trace: moves applied but not yet on screen
+    std::thread th;
+
+    bool push(RenderMsg m){
+        m.seq = pub_seq.fetch_add(1, std::memory_order_relaxed) + 1;
+        if(q.try_push(m)) return true;
+        resync.store(true, std::memory_order_relaxed);
+        return false;
+    }
+    void snapshot();
+    void print();
+    void made_frame(bool &pending);
+    void event_text(const RenderMsg &m);
+    void loop();
+
+public:
+    Renderer(Board &board, const Options &opt, int steps);
+
+    // Producer side: the commit stage, holding board.mtx. decided: --trace time
+    // of the move this frame shows, if any
+    void frame(int steps, uint64_t decided = 0, int t = 0){
+        for(uint32_t i : b.scr.dirty) push({RenderMsg::Cell, 0, 0, b.scr.grid[i], i});
+        b.scr.dirty.clear();
+        pub_steps = steps;
+        push({RenderMsg::Frame, t, 0, 0, 0, steps, 0, decided, decided ? trace_now() : 0});
+    }
+    void jump(int t, Pos to){ push({RenderMsg::Jump, t, 0, 0, (uint32_t)(to.r*b.C + to.c)}); }
+    void shot(int t, int target, int ms){ push({RenderMsg::Shot, t, target, 0, 0, ms}); }
+
+    // --sync cas, any thread, no lock. A move is published before the mover
+    // releases its old cell, so whoever claims that cell next queues after it.
+    void move(int t, Pos from, Pos to, char ground, char glyph, uint64_t decided = 0){
+        if(!push({RenderMsg::Move, t, from.r*b.C + from.c, glyph, (uint32_t)(to.r*b.C + to.c), ground, 0, decided, decided ? trace_now() : 0}))
+            dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    void cell(Pos p, char glyph){ push({RenderMsg::Cell, 0, 0, glyph, (uint32_t)(p.r*b.C + p.c)}); }
+
+    // Drain everything, then print the final board from the renderer's view
+    void finish(int steps);
+};
@@ -0,0 +1,144 @@
+#include "replay.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include "engine.hpp"
+#include "mapped_file.hpp"
+#include "render.hpp"
+
+using namespace std;
+
+static const char REPLAY_MAGIC[8] = {'T','O','O','N','R','E','P','1'};
+
+ReplayWriter::ReplayWriter(const string &path, const Board &b, unsigned seed, bool clock_ms){
+    f = fopen(path.c_str(), "wb");
+    if(!f) return;
+    buf.reserve(CAP);
+    ReplayHeader h{};
+    memcpy(h.magic, REPLAY_MAGIC, sizeof h.magic);
+    h.rows = (uint32_t)b.R; h.cols = (uint32_t)b.C; h.toons = (uint32_t)b.n; h.seed = seed;
+    h.clock_ms = clock_ms;
+    fwrite(&h, sizeof h, 1, f);
+    for(int r=0;r<b.R;r++) fwrite(b.row(r), 1, b.C, f);
+    for(int t=0;t<b.n;t++){ uint32_t c = cell_id(b, b.pos(t)); fwrite(&c, sizeof c, 1, f); }
+}
+
+ReplayWriter::~ReplayWriter(){
+    if(!f) return;
+    flush();
+    fclose(f);
+}
+
+void ReplayWriter::flush(){
+    if(f && !buf.empty()) fwrite(buf.data(), sizeof(ReplayRecord), buf.size(), f);
+    buf.clear();
+}
+
+static int replay_error(const Options &opt, const char *why){
+    cerr << "toons: " << opt.replay << ": " << why << "\n";
+    return 1;
+}
+
+int run_replay(const Options &opt){
+    MappedFile file(opt.replay);
+    if(!file.data()) return replay_error(opt, "cannot read replay");
+    if(file.size() < sizeof(ReplayHeader)) return replay_error(opt, "truncated header");
+    ReplayHeader h;
+    memcpy(&h, file.data(), sizeof h);
+    if(memcmp(h.magic, REPLAY_MAGIC, sizeof h.magic) != 0) return replay_error(opt, "not a toons replay");
+    if(h.rows < 1 || h.rows > INT16_MAX || h.cols < 3 || h.cols > INT16_MAX || h.toons < 1)
+        return replay_error(opt, "bad board size");
+    const size_t cells = (size_t)h.rows*h.cols;
+    const size_t body = sizeof h + cells + (size_t)h.toons*sizeof(uint32_t);
+    if(file.size() < body) return replay_error(opt, "truncated board");
+
+    Board board((int)h.rows, (int)h.cols, (int)h.toons);
+    board.scr.live = !opt.stacked;
+    const unsigned char *p = file.data() + sizeof h;
+    for(int r=0;r<board.R;r++) memcpy(board.edit_row(r), p + (size_t)r*board.C, board.C);
+    board.pack_open();
+    p += cells;
+    for(int t=0;t<board.n;t++){
+        uint32_t c; memcpy(&c, p + (size_t)t*sizeof c, sizeof c);
+        if(c >= cells) return replay_error(opt, "bad start cell");
+        place_toon(board, t, {(int)(c / board.C), (int)(c % board.C)});
+    }
+
+    // Records follow the variable-size board, so they are copied out, not cast
+    const unsigned char *recs = file.data() + body;
+    const size_t count = (file.size() - body) / sizeof(ReplayRecord);
+    auto at = [&](size_t i){ ReplayRecord r; memcpy(&r, recs + i*sizeof r, sizeof r); return r; };
+
+    int winner = -1, steps = 0;
+    vector<string> events;
+    auto apply = [&](const ReplayRecord &r){
+        const int t = r.toon();
+        if(t >= board.n) return;
+        switch(r.kind()){
+        case ReplayRecord::MOVE:
+        case ReplayRecord::JUMP: {
+            if(r.to >= cells) return;
+            // --sync cas logs are only ordered to the ms, so a toon may arrive on a
+            // cell before the previous owner's record has left it
+            Pos old = board.pos(t), dest{(int)(r.to / board.C), (int)(r.to % board.C)};
+            if(board.occupant(board.idx(old.r,old.c)) == t){
+                set_occupant(board, board.idx(old.r,old.c), -1);
+                if(board.render) patch(board, old, board.at(old.r,old.c));
+            }
+            place_toon(board, t, dest); board.steps[t]++;
+            if(board.render) patch(board, dest, toon_glyph(board,t));
+            steps++;
+            if(r.kind() == ReplayRecord::JUMP && board.render)
+                events.push_back("[Replay] " + toon_name(board, t) + " jumps to (" + to_string(dest.r) + "," + to_string(dest.c) + ")");
+            break;
+        }
+        case ReplayRecord::FREEZE:
+            set_frozen(board, t, true);
+            if(board.render && (int)r.from < board.n)
+                events.push_back("[Replay] " + toon_name(board, (int)r.from) + " shoots " + toon_name(board, t) + " — frozen for " + to_string(r.to) + " ms");
+            break;
+        case ReplayRecord::THAW: set_frozen(board, t, false); break;
+        case ReplayRecord::WIN:  winner = t; break;
+        }
+    };
+    auto when = [&](long long k){ return h.clock_ms ? "t=" + to_string(k) + " ms" : "tick " + to_string(k); };
+
+    if(opt.frame >= 0){
+        board.render = false;                        // one repaint at the end is enough
+        size_t i = 0;
+        for(; i<count; i++){
+            ReplayRecord r = at(i);
+            if(r.tick > opt.frame) break;
+            apply(r);
+        }
+        rebuild_grid(board);
+        print_board(board.scr, steps);
+        end_live(board.scr);
+        cout << "Replay: " << when(opt.frame) << ", " << i << " of " << count << " records\n";
+        print_summary(board, winner);
+        return 0;
+    }
+
+    // Frames are one per logged tick; --frames fps counts log time (ticks at delay-ms each)
+    rebuild_grid(board);
+    FrameGate gate(opt);
+    if(gate.boards()) print_board(board.scr, steps);
+    bool shown = true;
+    for(size_t i=0, n=0; i<count && !gStop.load();){
+        const uint32_t tick = at(i).tick;
+        for(; i<count && at(i).tick == tick; i++) apply(at(i));
+        if((shown = gate.take((long long)++n, h.clock_ms ? tick : (long long)tick * opt.delay_ms))) print_board(board.scr, steps);
+        else skip_frame(board.scr);
+        if(gate.events()) for(const string &e : events) print_event(board.scr, e);
+        events.clear();
+        if(gate.all()) this_thread::sleep_for(chrono::milliseconds(opt.delay_ms));
+    }
+    if(!shown) print_board(board.scr, steps);
+    end_live(board.scr);
+    cout << "Replay: " << count << " records\n";
+    print_summary(board, winner);
+    return 0;
+}
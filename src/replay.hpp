@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "board.hpp"
+#include "options.hpp"
+
+// ---- Replay log (--record / --replay) ----
+// File: ReplayHeader, the static cells (R*C bytes, row-major), the start cell of
+// every toon (uint32 each), then fixed-size records to the end of the file in
+// commit order. Cells are r*C+c. Records carry their own time, so a frame is
+// rebuilt by applying every record up to it; nothing is simulated again.
+
+struct ReplayHeader {
+    char magic[8];                       // "TOONREP1"
+    uint32_t rows, cols, toons, seed;
+    uint32_t clock_ms;                   // 0: record time is the headless tick, 1: ms since start (threaded)
+    uint32_t reserved;
+};
+
+struct ReplayRecord {
+    enum Kind : uint8_t { MOVE, JUMP, FREEZE, THAW, WIN };
+    uint32_t tick;
+    uint32_t toon_kind;                  // toon << 8 | Kind
+    uint32_t from, to;                   // MOVE, JUMP: cells; FREEZE: from = shooter, to = freeze ms
+
+    int toon() const { return (int)(toon_kind >> 8); }
+    Kind kind() const { return (Kind)(toon_kind & 0xff); }
+};
+static_assert(sizeof(ReplayRecord) == 16, "records are written as raw 16-byte structs");
+
+inline uint32_t cell_id(const Board &b, Pos p){ return (uint32_t)(p.r*b.C + p.c); }
+
+// Buffers records and writes them CAP at a time; add() is a store and a compare.
+// Not thread-safe: headless and --sync lock call it from one thread or under
+// board.mtx, --sync cas workers keep their own vectors and append() at the end.
+class ReplayWriter {
+    static constexpr size_t CAP = 4096;
+    std::FILE *f = nullptr;
+    std::vector<ReplayRecord> buf;
+    void flush();
+public:
+    // Writes the header and the board as set up; check ok() afterwards
+    ReplayWriter(const std::string &path, const Board &b, unsigned seed, bool clock_ms);
+    ~ReplayWriter();
+    ReplayWriter(const ReplayWriter &) = delete;
+    ReplayWriter &operator=(const ReplayWriter &) = delete;
+    bool ok() const { return f != nullptr; }
+
+    static ReplayRecord record(long long tick, ReplayRecord::Kind k, int toon, uint32_t from = 0, uint32_t to = 0){
+        return {(uint32_t)tick, (uint32_t)toon << 8 | k, from, to};
+    }
+    void add(const ReplayRecord &r){
+        buf.push_back(r);
+        if(buf.size() == CAP) flush();
+    }
+    void add(long long tick, ReplayRecord::Kind k, int toon, uint32_t from = 0, uint32_t to = 0){
+        add(record(tick, k, toon, from, to));
+    }
+    void append(const std::vector<ReplayRecord> &v){ for(const ReplayRecord &r : v) add(r); }
+};
+
+// --replay FILE: play the log back as frames, or print the single frame at
+// opt.frame (the board after every record with time <= frame)
+int run_replay(const Options &opt);
@@ -0,0 +1,106 @@
+#include "results.hpp"
+
+using namespace std;
+
+static const char RESULTS_MAGIC[8] = {'T','O','O','N','R','E','S','1'};
+static constexpr uint32_t RESULTS_VERSION = 1;
+
+uint64_t options_hash(const Options &o){
+    uint64_t h = 0xcbf29ce484222325ull;
+    auto mix = [&](const void *p, size_t n){
+        const unsigned char *c = (const unsigned char*)p;
+        for(size_t i=0;i<n;i++){ h ^= c[i]; h *= 0x100000001b3ull; }
+    };
+    auto num = [&](auto v){ mix(&v, sizeof v); };
+    num(o.rows); num(o.cols); num(o.toons); num(o.maxSteps); num(o.delay_ms);
+    num((uint8_t)o.policy); num((uint8_t)o.rng); num((uint8_t)o.sched);
+    num(o.rr_burst_chance); num(o.coy_jump_chance); num(o.sam_shoot_chance);
+    num(o.sam_cooldown_ms); num(o.sam_freeze_ms); num(o.forkAt);
+    mix(o.map.data(), o.map.size());
+    return h;
+}
+
+ResultsFile::ResultsFile(const string &path){
+    // An existing file must already be a results file; new blocks go after its last
+    if(FILE *in = fopen(path.c_str(), "rb")){
+        ResultsHeader h{};
+        const size_t got = fread(&h, 1, sizeof h, in);
+        fclose(in);
+        if(got != 0 && (got != sizeof h || memcmp(h.magic, RESULTS_MAGIC, sizeof h.magic) != 0 || h.version != RESULTS_VERSION)) return;
+    }
+    f = fopen(path.c_str(), "ab");
+    if(!f) return;
+    fseek(f, 0, SEEK_END);
+    if(ftell(f) == 0){
+        ResultsHeader h{};
+        memcpy(h.magic, RESULTS_MAGIC, sizeof h.magic);
+        h.version = RESULTS_VERSION;
+        fwrite(&h, sizeof h, 1, f);
+        fflush(f);
+    }
+}
+
+ResultsFile::~ResultsFile(){
+    if(f) fclose(f);
+}
+
+void ResultsFile::write(const vector<unsigned char> &block){
+    lock_guard<mutex> lk(mtx);
+    fwrite(block.data(), 1, block.size(), f);
+    fflush(f);
+}
+
+void ResultsBuffer::add(unsigned raceSeed, uint64_t optHash, const Board &b, const RaceResult &res){
+    if(!file) return;
+    if(races && toons != (uint32_t)b.n) flush();
+    toons = (uint32_t)b.n;
+    hash.push_back(optHash);
+    seed.push_back(raceSeed);
+    winner.push_back(res.winner);
+    counts[R_TICKS].push_back((uint32_t)res.ticks);
+    counts[R_STEPS].push_back((uint32_t)res.totalSteps);
+    counts[R_JUMPS].push_back((uint32_t)res.jumps);
+    counts[R_BURSTS].push_back((uint32_t)res.bursts);
+    counts[R_SHOTS].push_back((uint32_t)res.shots);
+    counts[R_FREEZES].push_back((uint32_t)res.freezes);
+    steps.insert(steps.end(), b.steps.begin(), b.steps.begin() + b.n);
+    if(++races == CAP || steps.size() >= STEPS_CAP) flush();
+}
+
+void ResultsBuffer::flush(){
+    if(!races) return;
+    const ResultsBlockHeader h{races, toons};
+    out.resize(sizeof h + results_block_bytes(races, toons));
+    unsigned char *p = out.data();
+    auto put = [&](const void *src, size_t n){ memcpy(p, src, n); p += n; };
+    put(&h, sizeof h);
+    put(hash.data(), 8*(size_t)races);
+    put(seed.data(), 4*(size_t)races);
+    put(winner.data(), 4*(size_t)races);
+    for(auto &c : counts) put(c.data(), 4*(size_t)races);
+    for(uint32_t t=0;t<toons;t++)
+        for(uint32_t i=0;i<races;i++){ const uint32_t s = steps[(size_t)i*toons + t]; put(&s, 4); }
+    file->write(out);
+    races = 0;
+    hash.clear(); seed.clear(); winner.clear(); steps.clear();
+    for(auto &c : counts) c.clear();
+}
+
+bool results_blocks(const unsigned char *p, size_t n, vector<ResultsBlock> &out, string &err){
+    ResultsHeader h;
+    if(n < sizeof h){ err = "not a results file"; return false; }
+    memcpy(&h, p, sizeof h);
+    if(memcmp(h.magic, RESULTS_MAGIC, sizeof h.magic) != 0){ err = "not a results file"; return false; }
+    if(h.version != RESULTS_VERSION){ err = "unsupported results version " + to_string(h.version); return false; }
+    for(size_t at = sizeof h; at + sizeof(ResultsBlockHeader) <= n;){
+        ResultsBlockHeader bh;
+        memcpy(&bh, p + at, sizeof bh);
+        // Divide rather than multiply: a corrupt races x toons must not wrap past the check
+        const size_t room = n - at - sizeof bh;
+        if(bh.races == 0 || bh.races > room / results_race_bytes(bh.toons)) break;
+        const size_t body = results_block_bytes(bh.races, bh.toons);
+        out.push_back({bh.races, bh.toons, p + at + sizeof bh});
+        at += sizeof bh + body;
+    }
+    return true;
+}
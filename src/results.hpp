@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "board.hpp"
+#include "engine.hpp"
+#include "options.hpp"
+
+// ---- Results file (--results FILE, read by toons_agg) ----
+// File: ResultsHeader, then blocks to the end of the file. A block is a
+// ResultsBlockHeader and one column per field, each `races` entries long:
+// options hash (uint64), seed, winner (int32, -1 for none), ticks, steps,
+// jumps, bursts, shots, freezes, then one steps column per toon (uint32 unless
+// noted), so per-race counts and per-toon steps scan without touching the rest.
+// Runs append blocks to an existing file, and every block is flushed whole, so
+// a reader stops cleanly at a block cut short by a crash.
+
+struct ResultsHeader {
+    char magic[8];                       // "TOONRES1"
+    uint32_t version, reserved;
+};
+
+struct ResultsBlockHeader {
+    uint32_t races, toons;
+};
+
+enum ResultCount : uint8_t { R_TICKS, R_STEPS, R_JUMPS, R_BURSTS, R_SHOTS, R_FREEZES, NRESULTCOUNTS };
+
+// Bytes of one race's row across every column of a block of toons
+inline uint64_t results_race_bytes(uint32_t toons){
+    return 8 + 4 + 4 + 4*NRESULTCOUNTS + 4*(uint64_t)toons;
+}
+
+// Bytes of a block of races x toons after its header
+inline size_t results_block_bytes(uint32_t races, uint32_t toons){
+    return (size_t)(races * results_race_bytes(toons));
+}
+
+// One block as mapped: columns are read with memcpy, since blocks need not be aligned
+struct ResultsBlock {
+    uint32_t races = 0, toons = 0;
+    const unsigned char *base = nullptr;  // first column
+
+    template<class T> static T get(const unsigned char *col, uint32_t i){ T v; std::memcpy(&v, col + sizeof(T)*i, sizeof v); return v; }
+    uint64_t hash(uint32_t i) const { return get<uint64_t>(base, i); }
+    uint32_t seed(uint32_t i) const { return get<uint32_t>(base + 8*(size_t)races, i); }
+    int32_t winner(uint32_t i) const { return get<int32_t>(base + 12*(size_t)races, i); }
+    uint32_t count(ResultCount c, uint32_t i) const { return get<uint32_t>(base + (16 + 4*(size_t)c)*races, i); }
+    uint32_t steps(uint32_t t, uint32_t i) const { return get<uint32_t>(base + (16 + 4*((size_t)NRESULTCOUNTS + t))*races, i); }
+};
+
+// Every whole block of a mapped results file, in file order; false with err set
+// if it is not a results file. A block cut short at the end is left out.
+bool results_blocks(const unsigned char *p, size_t n, std::vector<ResultsBlock> &out, std::string &err);
+
+// FNV-1a over every option that changes how a race plays (not the seed, the
+// worker count or anything about output), so races of one setup group together
+uint64_t options_hash(const Options &o);
+
+// The open file; write() appends one block and flushes it under a lock
+class ResultsFile {
+    std::FILE *f = nullptr;
+    std::mutex mtx;
+public:
+    explicit ResultsFile(const std::string &path);   // check ok() afterwards
+    ~ResultsFile();
+    ResultsFile(const ResultsFile &) = delete;
+    ResultsFile &operator=(const ResultsFile &) = delete;
+    bool ok() const { return f != nullptr; }
+    void write(const std::vector<unsigned char> &block);
+};
+
+// One worker's rows, kept column by column and written CAP races (or STEPS_CAP
+// toon steps) at a time, or when a race with a different toon count comes in.
+// Reused buffers, so a warm worker adds a race without allocating.
+class ResultsBuffer {
+    static constexpr uint32_t CAP = 4096;
+    static constexpr size_t STEPS_CAP = 1 << 20;
+    ResultsFile *file;
+    uint32_t races = 0, toons = 0;
+    std::vector<uint32_t> seed;
+    std::vector<uint64_t> hash;
+    std::vector<int32_t> winner;
+    std::vector<uint32_t> counts[NRESULTCOUNTS];
+    std::vector<uint32_t> steps;         // [race][toon]; transposed into columns on flush
+    std::vector<unsigned char> out;
+public:
+    explicit ResultsBuffer(ResultsFile *f) : file(f) {}
+    ~ResultsBuffer(){ flush(); }
+    ResultsBuffer(const ResultsBuffer &) = delete;
+    ResultsBuffer &operator=(const ResultsBuffer &) = delete;
+    // No-op without a file
+    void add(unsigned raceSeed, uint64_t optHash, const Board &b, const RaceResult &res);
+    void flush();
+};
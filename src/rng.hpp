@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// ---- Random streams ----
+// Every toon draws from its own stream, so a race is a pure function of the
+// seed whatever order the turns run in. Two backends, picked with --rng:
+// mt19937 (the original streams, ~5 KB per toon) and xoshiro256** with
+// jump-ahead streams, drawn in blocks (~170 bytes per toon). Movement code is
+// written against uniform01/below and takes either.
+
+struct Xoshiro256 {                      // xoshiro256** 1.0 (Blackman & Vigna)
+    uint64_t s[4];
+
+    explicit Xoshiro256(uint64_t seed){
+        for(uint64_t &w : s){           // splitmix64 so that any seed gives a non-zero state
+            uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            w = z ^ (z >> 31);
+        }
+    }
+    static uint64_t rotl(uint64_t x, int k){ return (x << k) | (x >> (64 - k)); }
+    uint64_t next(){
+        const uint64_t r = rotl(s[1] * 5, 7) * 9, t = s[1] << 17;
+        s[2] ^= s[0]; s[3] ^= s[1]; s[1] ^= s[2]; s[0] ^= s[3];
+        s[2] ^= t; s[3] = rotl(s[3], 45);
+        return r;
+    }
+    // Advance 2^128 draws: consecutive jumps give non-overlapping streams
+    void jump(){
+        static const uint64_t J[4] = {0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull, 0x39abdc4529b1661cull};
+        uint64_t t[4] = {0, 0, 0, 0};
+        for(uint64_t j : J) for(int b=0;b<64;b++){
+            if(j & (1ull << b)){ t[0] ^= s[0]; t[1] ^= s[1]; t[2] ^= s[2]; t[3] ^= s[3]; }
+            next();
+        }
+        for(int i=0;i<4;i++) s[i] = t[i];
+    }
+};
+
+// xoshiro stream that refills BLOCK outputs at a time in one tight loop
+class FastRng {
+    static constexpr unsigned BLOCK = 16;
+    Xoshiro256 g;
+    unsigned i = BLOCK;
+    uint64_t buf[BLOCK];
+public:
+    explicit FastRng(const Xoshiro256 &gen) : g(gen) {}
+    uint64_t next(){
+        if(i == BLOCK){ for(uint64_t &v : buf) v = g.next(); i = 0; }
+        return buf[i++];
+    }
+};
+
+// mt19937 keeps the std distributions, so old seeds replay bit for bit
+inline double uniform01(std::mt19937 &r){ return std::uniform_real_distribution<double>(0.0,1.0)(r); }
+inline int below(std::mt19937 &r, int n){ return std::uniform_int_distribution<int>(0,n-1)(r); }
+
+inline double uniform01(FastRng &r){ return (double)(r.next() >> 11) * 0x1.0p-53; }
+inline int below(FastRng &r, int n){ return (int)(((r.next() >> 32) * (uint64_t)n) >> 32); }  // multiply-shift, n small
+
+// Streams for toons 0..n-1 of a race seeded with seed
+template<class Rng> std::vector<Rng> toon_streams(unsigned seed, int n);
+
+template<> inline std::vector<std::mt19937> toon_streams(unsigned seed, int n){
+    std::vector<std::mt19937> v; v.reserve(n);
+    for(int t=0;t<n;t++) v.emplace_back(seed + 777u*(t+1));
+    return v;
+}
+
+template<> inline std::vector<FastRng> toon_streams(unsigned seed, int n){
+    std::vector<FastRng> v; v.reserve(n);
+    Xoshiro256 g(seed);
+    for(int t=0;t<n;t++){ v.emplace_back(g); g.jump(); }
+    return v;
+}
+
+// The same streams as toon_streams, written over v in place
+inline void reseed_streams(std::vector<std::mt19937> &v, unsigned seed){
+    for(size_t t=0;t<v.size();t++) v[t].seed(seed + 777u*(unsigned)(t+1));
+}
+inline void reseed_streams(std::vector<FastRng> &v, unsigned seed){
+    Xoshiro256 g(seed);
+    for(FastRng &r : v){ r = FastRng(g); g.jump(); }
+}
@@ -0,0 +1,399 @@
+#include "serve.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "batch.hpp"
+#include "board.hpp"
+#include "engine.hpp"
+#include "map.hpp"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace {
+
+constexpr size_t POOL_SHAPES = 4;       // boards a worker keeps, one per shape
+constexpr size_t LAYOUT_BYTES = 64 << 20;   // budget of the shared layout cache
+constexpr size_t MAX_LINE = 64 << 10;   // a connection (or stdin) sending longer lines is dropped
+constexpr int LAT_BUCKETS = 40;         // log2(us) buckets, as in stats
+
+// Where a spec came from and where its result goes. Several workers may finish
+// races of one client at once, so sends are serialized per client; the socket
+// closes once the reader is done and the last of its results has been sent.
+class Client {
+    int fd;                              // -1: stdout
+    mutex mtx;
+public:
+    explicit Client(int f) : fd(f) {}
+    ~Client(){
+#ifndef _WIN32
+        if(fd >= 0) close(fd);
+#endif
+    }
+    Client(const Client &) = delete;
+    Client &operator=(const Client &) = delete;
+
+    void send(const string &line){
+        lock_guard<mutex> lk(mtx);
+#ifndef _WIN32
+        if(fd >= 0){
+            for(size_t at = 0; at < line.size();){
+                ssize_t k = ::send(fd, line.data() + at, line.size() - at, 0);
+                if(k < 0 && errno == EINTR) continue;
+                if(k <= 0) return;           // client gone: its results are dropped
+                at += (size_t)k;
+            }
+            return;
+        }
+#endif
+        cout << line << flush;
+    }
+};
+
+struct Job {
+    string id;
+    Options opt;
+    const MapFile *map = nullptr;
+    shared_ptr<Client> client;
+    Clock::time_point t0{};              // when the spec was read
+};
+
+// Bounded FIFO: push waits while full, pop waits while empty; after close() pops
+// drain what is left and then fail
+class JobQueue {
+    deque<Job> q;
+    const size_t cap;
+    bool closed = false;
+    mutex mtx;
+    condition_variable notFull, notEmpty;
+public:
+    explicit JobQueue(size_t c) : cap(c) {}
+    void push(Job &&j){
+        unique_lock<mutex> lk(mtx);
+        notFull.wait(lk, [&]{ return q.size() < cap || closed; });
+        if(closed) return;
+        q.push_back(move(j));
+        lk.unlock();
+        notEmpty.notify_one();
+    }
+    bool pop(Job &j){
+        unique_lock<mutex> lk(mtx);
+        notEmpty.wait(lk, [&]{ return !q.empty() || closed; });
+        if(q.empty()) return false;
+        j = move(q.front()); q.pop_front();
+        lk.unlock();
+        notFull.notify_one();
+        return true;
+    }
+    void close(){
+        { lock_guard<mutex> lk(mtx); closed = true; }
+        notFull.notify_all(); notEmpty.notify_all();
+    }
+};
+
+// Maps by (path, toons), checked on first use and kept mapped
+class MapCache {
+    mutex mtx;
+    map<pair<string,int>, unique_ptr<MapFile>> maps;
+public:
+    const MapFile *get(const string &path, int toons, string &err){
+        lock_guard<mutex> lk(mtx);
+        unique_ptr<MapFile> &m = maps[{path, toons}];
+        if(!m) m = make_unique<MapFile>(path, toons);
+        if(!m->ok()){ err = path + ": " + m->error(); return nullptr; }
+        return m.get();
+    }
+};
+
+// Set-up boards of recent specs, keyed by everything setup_board (or a map's
+// load) draws on, shared by all workers. A spec that repeats a layout (the same
+// seed with other ability settings, say) loads it copy-on-write instead of
+// drawing walls and starts and building the distance field again. Oldest
+// entries go once the layers would take more than LAYOUT_BYTES.
+class LayoutCache {
+    using Key = tuple<int, int, int, unsigned, bool, const MapFile *>;   // rows, cols, toons, seed, field, map
+    using Entry = pair<Key, shared_ptr<const Layout>>;
+    mutex mtx;
+    list<Entry> lru;                     // most recent first
+    map<Key, list<Entry>::iterator> at;
+    size_t bytes = 0;
+    static size_t size_of(const Layout &l){
+        return l.layer->cell.size() + 4*l.layer->dist.size() + 8*l.layer->open.size() + sizeof(Pos)*l.starts.size();
+    }
+public:
+    static Key key(const Options &o, const MapFile *m){ return Key{o.rows, o.cols, o.toons, o.seed, o.policy == Policy::FIELD, m}; }
+    shared_ptr<const Layout> get(const Key &k){
+        lock_guard<mutex> lk(mtx);
+        auto it = at.find(k);
+        if(it == at.end()) return nullptr;
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->second;
+    }
+    void put(const Key &k, Layout &&l){
+        const size_t n = size_of(l);
+        if(n > LAYOUT_BYTES) return;
+        lock_guard<mutex> lk(mtx);
+        if(at.count(k)) return;          // another worker set it up first
+        lru.emplace_front(k, make_shared<const Layout>(move(l)));
+        at[k] = lru.begin();
+        for(bytes += n; bytes > LAYOUT_BYTES;){
+            bytes -= size_of(*lru.back().second);
+            at.erase(lru.back().first);
+            lru.pop_back();
+        }
+    }
+};
+
+// A board and a race kept warm for one shape. The race holds a reference to ro,
+// so a slot stays put on the heap while the pool reorders.
+struct Slot {
+    Options ro;
+    unique_ptr<Board> board;
+    unique_ptr<HeadlessRace> race;
+    explicit Slot(const Options &o) : ro(o) {}
+    // Everything Board and HeadlessRace size or fix at construction
+    bool fits(const Options &o) const {
+        return ro.rows == o.rows && ro.cols == o.cols && ro.toons == o.toons
+            && ro.sched == o.sched && ro.rng == o.rng && max(1, ro.delay_ms) == max(1, o.delay_ms);
+    }
+};
+
+// Per-worker submission-to-result times, merged for the report at exit
+struct alignas(64) ServeLatency {
+    array<uint64_t,LAT_BUCKETS> hist{};
+    uint64_t n = 0, maxUs = 0;
+    void add(uint64_t us){
+        int b = 0; for(uint64_t x = us; x && b < LAT_BUCKETS-1; x >>= 1) b++;
+        hist[b]++; n++; maxUs = max(maxUs, us);
+    }
+    void merge(const ServeLatency &o){
+        for(int b=0;b<LAT_BUCKETS;b++) hist[b] += o.hist[b];
+        n += o.n; maxUs = max(maxUs, o.maxUs);
+    }
+    uint64_t upper(double q) const {               // bucket upper bound holding quantile q
+        uint64_t want = (uint64_t)(q * n), seen = 0;
+        for(int b=0;b<LAT_BUCKETS;b++){ seen += hist[b]; if(seen > want) return min<uint64_t>(maxUs, b ? (1ull << b) - 1 : 0); }
+        return maxUs;
+    }
+};
+
+class Server {
+    const Options &base;
+    JobQueue queue;
+    MapCache maps;
+    LayoutCache layouts;
+    atomic<uint32_t> specs{0};
+    vector<ServeLatency> lat;
+    vector<thread> workers;
+
+    bool parse(const string &line, Job &job, string &err);
+    void work(int w);
+public:
+    explicit Server(const Options &opt) : base(opt), queue(64 * (size_t)opt.jobs), lat(opt.jobs) {
+        for(int w=0;w<opt.jobs;w++) workers.emplace_back(&Server::work, this, w);
+    }
+    void submit(string line, const shared_ptr<Client> &from);
+    void finish();
+};
+
+// "ID name=value ..." over job.opt (the server's options); the seed, if not given, comes
+// from the spec's arrival number
+bool Server::parse(const string &line, Job &job, string &err){
+    istringstream in(line);
+    in >> job.id;
+    Options &o = job.opt;
+    bool seeded = false;
+    for(string kv; in >> kv;){
+        const size_t eq = kv.find('=');
+        const string name = kv.substr(0, eq), value = eq == string::npos ? string() : kv.substr(eq + 1);
+        if(eq == string::npos || !set_option(o, name, value)){ err = "bad option '" + kv + "'"; return false; }
+        seeded |= name == "seed";
+    }
+    const uint32_t n = specs.fetch_add(1, memory_order_relaxed);
+    if(!seeded) o.seed = race_seed(base.seed, n);
+    clamp_options(o);
+    job.map = nullptr;
+    if(!o.map.empty()){
+        if(!(job.map = maps.get(o.map, o.toons, err))) return false;
+        o.rows = job.map->rows(); o.cols = job.map->cols();
+    }
+    return true;
+}
+
+void Server::submit(string line, const shared_ptr<Client> &from){
+    if(!line.empty() && line.back() == '\r') line.pop_back();
+    if(line.find_first_not_of(" \t") == string::npos || line[line.find_first_not_of(" \t")] == '#') return;
+    Job job;
+    job.opt = base; job.client = from; job.t0 = Clock::now();
+    string err;
+    if(!parse(line, job, err)){ from->send(job.id + " error " + err + "\n"); return; }
+    queue.push(move(job));
+}
+
+void Server::work(int w){
+    vector<unique_ptr<Slot>> pool;              // most recently used first
+    Job job;
+    while(queue.pop(job)){
+        // SIGINT: what is still queued is answered, not raced
+        if(gStop.load()){ job.client->send(job.id + " error cancelled\n"); job.client.reset(); continue; }
+        auto hit = find_if(pool.begin(), pool.end(), [&](const unique_ptr<Slot> &s){ return s->fits(job.opt); });
+        if(hit == pool.end()){
+            if(pool.size() == POOL_SHAPES) pool.pop_back();
+            pool.insert(pool.begin(), make_unique<Slot>(job.opt));
+        } else rotate(pool.begin(), hit, hit + 1);
+        Slot &s = *pool.front();
+        s.ro = job.opt;
+
+        const bool fresh = !s.board;
+        if(fresh) s.board = make_unique<Board>(s.ro.rows, s.ro.cols, s.ro.toons);
+        Board &board = *s.board;
+        const auto key = LayoutCache::key(s.ro, job.map);
+        if(shared_ptr<const Layout> l = layouts.get(key)) board.load(*l);
+        else {
+            if(!fresh) board.reset();
+            if(job.map) job.map->load(board, s.ro); else setup_board(board, s.ro);
+            layouts.put(key, board.layout());
+        }
+        if(!s.race) s.race = make_unique<HeadlessRace>(s.ro, board);
+        else s.race->reset();
+        while(!s.race->done()) s.race->tick();
+        if(gStop.load()){ job.client->send(job.id + " error cancelled\n"); job.client.reset(); continue; }
+
+        const RaceResult res = s.race->result();
+        const uint64_t us = (uint64_t)chrono::duration_cast<chrono::microseconds>(Clock::now() - job.t0).count();
+        job.client->send(job.id + " " + (res.winner >= 0 ? toon_name(board, res.winner) : string("none")) + " "
+                         + to_string(res.ticks) + " " + to_string(res.totalSteps) + " " + to_string(us) + "\n");
+        lat[w].add(us);
+        job.client.reset();
+    }
+}
+
+// No more specs: drain the queue, stop the workers and report latencies
+void Server::finish(){
+    queue.close();
+    for(auto &th : workers) th.join();
+    ServeLatency tot;
+    for(const ServeLatency &l : lat) tot.merge(l);
+    cerr << "serve: " << tot.n << " races on " << base.jobs << " workers, latency p50 <= " << tot.upper(0.5)
+         << " us, p99 <= " << tot.upper(0.99) << " us, max " << tot.maxUs << " us\n";
+}
+
+#ifndef _WIN32
+// Reads newline-separated specs from fd until it closes or SIGINT, polling so a
+// quiet peer or terminal never blocks the stop check
+void read_specs(Server &srv, int fd, const shared_ptr<Client> &client){
+    string buf;
+    char chunk[4096];
+    while(!gStop.load()){
+        pollfd p{fd, POLLIN, 0};
+        const int k = poll(&p, 1, 200);
+        if(k < 0 && errno != EINTR) break;
+        if(k <= 0) continue;
+        const ssize_t got = read(fd, chunk, sizeof chunk);
+        if(got < 0 && errno == EINTR) continue;
+        if(got <= 0){
+            if(got == 0 && !buf.empty()) srv.submit(move(buf), client);   // last line without a newline
+            break;
+        }
+        buf.append(chunk, (size_t)got);
+        size_t at = 0;
+        for(size_t nl; (nl = buf.find('\n', at)) != string::npos; at = nl + 1) srv.submit(buf.substr(at, nl - at), client);
+        buf.erase(0, at);
+        if(buf.size() > MAX_LINE){ client->send("- error line too long\n"); break; }
+    }
+}
+
+void serve_connection(Server &srv, int fd){
+    read_specs(srv, fd, make_shared<Client>(fd));
+    shutdown(fd, SHUT_RD);
+}
+
+int listen_loopback(int port){
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd < 0) return -1;
+    const int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(bind(fd, (const sockaddr*)&addr, sizeof addr) < 0 || listen(fd, 64) < 0){ close(fd); return -1; }
+    return fd;
+}
+#endif
+
+} // namespace
+
+int run_serve(const Options &opt){
+    int port = 0;
+    if(opt.serve != "-"){
+        char *end = nullptr;
+        const long p = strtol(opt.serve.c_str(), &end, 10);
+        if(*end || p < 1 || p > 65535){ cerr << "toons: --serve: expected - or a port, got '" << opt.serve << "'\n"; return 1; }
+        port = (int)p;
+    }
+#ifdef _WIN32
+    if(port){ cerr << "toons: --serve: TCP needs POSIX sockets here; use --serve -\n"; return 1; }
+#endif
+
+    Server srv(opt);
+    if(!port){
+        auto out = make_shared<Client>(-1);
+#ifdef _WIN32
+        for(string line; !gStop.load() && getline(cin, line);) srv.submit(move(line), out);
+#else
+        read_specs(srv, 0, out);
+#endif
+        srv.finish();
+        return 0;
+    }
+
+#ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN);                  // a client that hangs up fails its send, not the server
+    const int lfd = listen_loopback(port);
+    if(lfd < 0){ cerr << "toons: --serve: cannot listen on 127.0.0.1:" << port << "\n"; srv.finish(); return 1; }
+    cerr << "serve: listening on 127.0.0.1:" << port << " with " << opt.jobs << " workers\n";
+
+    struct Conn { thread th; atomic<bool> done{false}; };
+    list<Conn> conns;
+    while(!gStop.load()){
+        for(auto c = conns.begin(); c != conns.end();)        // reap connections that hung up
+            if(c->done.load()){ c->th.join(); c = conns.erase(c); } else ++c;
+        pollfd p{lfd, POLLIN, 0};
+        if(poll(&p, 1, 200) <= 0) continue;
+        const int fd = accept(lfd, nullptr, nullptr);
+        if(fd < 0) continue;
+        conns.emplace_back();
+        Conn &c = conns.back();
+        c.th = thread([&srv, &c, fd]{ serve_connection(srv, fd); c.done.store(true); });
+    }
+    close(lfd);
+    for(Conn &c : conns) c.th.join();
+#endif
+    srv.finish();
+    return 0;
+}
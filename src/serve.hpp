@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+#include "options.hpp"
+
+// ---- Race server (--serve SRC) ----
+// A long-running process that takes one race spec per line and answers with one
+// result line per race, in the order they finish:
+//   spec:    ID [name=value ...]      names as set_option: seed, rows, toons, map, ...
+//   result:  ID WINNER TICKS STEPS US (WINNER "none" if nobody got there; US is
+//            microseconds from reading the spec to the result being written)
+//   error:   ID error WHY
+// Unset names take the server's own command-line options, and a spec without a
+// seed gets race_seed(opt.seed, n) for the n-th spec the server has read.
+// SRC "-" serves stdin/stdout until end of input; a port number listens on
+// 127.0.0.1 and serves any number of connections until SIGINT.
+
+// opt.jobs workers race specs in FIFO order from one bounded queue; when it is
+// full the readers stop reading, so a burst backs up into the client instead of
+// into the server's latency. Each worker keeps a few boards (and races) per
+// board shape and only resets them between specs; maps are checked once per
+// path and toon count and stay mapped for the life of the server, and set-up
+// layouts are cached by seed, so a repeated seed skips board setup entirely.
+int run_serve(const Options &opt);
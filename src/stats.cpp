@@ -0,0 +1,103 @@
+#include "stats.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+#if TOONS_STATS
+
+static const char *COUNTER_NM[NCOUNTERS] = {"moves", "blocked", "jumps", "bursts", "shots", "frozen_turns", "frozen_ms", "locks", "locks_contended"};
+static const char *PHASE_NM[NPHASES] = {"lock_wait", "render", "rebuild_grid", "sleep"};
+
+bool gStatsTiming = false;
+
+void set_stats_timing(bool on){ gStatsTiming = on; }
+
+static mutex gStatsMtx;
+static vector<unique_ptr<ThreadStats>> gStatsAll;   // one per thread that ever counted
+
+ThreadStats &stats_local(){
+    thread_local ThreadStats *mine = nullptr;
+    if(!mine){
+        lock_guard<mutex> lk(gStatsMtx);
+        gStatsAll.push_back(make_unique<ThreadStats>());
+        mine = gStatsAll.back().get();
+    }
+    return *mine;
+}
+
+void ThreadStats::merge(const ThreadStats &o){
+    for(int c=0;c<NCOUNTERS;c++) count[c] += o.count[c];
+    for(int p=0;p<NPHASES;p++){
+        calls[p] += o.calls[p]; ns[p] += o.ns[p];
+        for(int b=0;b<STAT_BUCKETS;b++) hist[p][b] += o.hist[p][b];
+    }
+}
+
+// Call once the threads that counted are done
+static ThreadStats stats_total(){
+    ThreadStats tot;
+    lock_guard<mutex> lk(gStatsMtx);
+    for(auto &s : gStatsAll) tot.merge(*s);
+    return tot;
+}
+
+// Upper bound (ns) of the bucket holding the q-th quantile
+static uint64_t quantile_ns(const ThreadStats &s, int p, double q){
+    if(!s.calls[p]) return 0;
+    uint64_t want = (uint64_t)(q * (double)s.calls[p]), seen = 0;
+    for(int b=0;b<STAT_BUCKETS;b++){
+        seen += s.hist[p][b];
+        if(seen > want) return b ? (1ull << b) - 1 : 0;
+    }
+    return ~0ull;
+}
+
+void print_stats(){
+    const ThreadStats s = stats_total();
+    cout << "=== Stats ===\n";
+    for(int c=0;c<NCOUNTERS;c++) cout << COUNTER_NM[c] << ": " << s.count[c] << (c+1<NCOUNTERS ? "  " : "\n");
+    cout << fixed << setprecision(3);
+    for(int p=0;p<NPHASES;p++){
+        if(!s.calls[p]) continue;
+        cout << PHASE_NM[p] << ": " << s.calls[p] << " x, " << s.ns[p]/1e6 << " ms total, p50 <= " << quantile_ns(s,p,0.5)
+             << " ns, p99 <= " << quantile_ns(s,p,0.99) << " ns\n";
+    }
+    if(!gStatsTiming) cout << "(phase timings need --stats or --stats-json)\n";
+}
+
+bool write_stats_json(const string &path){
+    const ThreadStats s = stats_total();
+    ofstream out(path);
+    if(!out) return false;
+    out << "{\n  \"counters\": {";
+    for(int c=0;c<NCOUNTERS;c++) out << (c ? ", " : "") << "\"" << COUNTER_NM[c] << "\": " << s.count[c];
+    out << "},\n  \"phases\": {\n";
+    for(int p=0;p<NPHASES;p++){
+        int last = 0;
+        for(int b=0;b<STAT_BUCKETS;b++) if(s.hist[p][b]) last = b;
+        out << "    \"" << PHASE_NM[p] << "\": {\"calls\": " << s.calls[p] << ", \"ns\": " << s.ns[p] << ", \"log2_ns_hist\": [";
+        for(int b=0;b<=last;b++) out << (b ? ", " : "") << s.hist[p][b];
+        out << "]}" << (p+1<NPHASES ? ",\n" : "\n");
+    }
+    out << "  }\n}\n";
+    return (bool)out;
+}
+
+#else
+
+void set_stats_timing(bool){}
+
+void print_stats(){ cout << "=== Stats ===\n(compiled out: TOONS_STATS=0)\n"; }
+
+bool write_stats_json(const string &path){
+    ofstream out(path);
+    out << "{\"compiled_out\": true}\n";
+    return (bool)out;
+}
+
+#endif
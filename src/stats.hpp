@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "trace.hpp"
+
+// ---- Run statistics (--stats, --stats-json) ----
+// Every thread counts into its own ThreadStats, so the hot path is a plain add
+// on a private cache line; the registry merges them when the run is reported.
+// Phase timings read the clock only while stats were requested. Building with
+// -DTOONS_STATS=0 (CMake option TOONS_STATS=OFF) turns all of it into empty
+// inline calls.
+
+#ifndef TOONS_STATS
+#define TOONS_STATS 1
+#endif
+
+enum Counter : uint8_t { MOVES, BLOCKED, JUMPS, BURSTS, SHOTS, FROZEN_TURNS, FROZEN_MS, LOCKS, LOCKS_CONTENDED, NCOUNTERS };
+enum Phase : uint8_t { LOCK_WAIT, RENDER, REBUILD, SLEEP, NPHASES };
+
+constexpr int STAT_BUCKETS = 40;                 // log2(ns) buckets: 0, 1, 2-3, 4-7, ...
+
+#if TOONS_STATS
+
+struct alignas(64) ThreadStats {
+    uint64_t count[NCOUNTERS] = {};
+    uint64_t calls[NPHASES] = {}, ns[NPHASES] = {};
+    uint64_t hist[NPHASES][STAT_BUCKETS] = {};
+
+    void add(Counter c, uint64_t v = 1){ count[c] += v; }
+    void time(Phase p, uint64_t d){
+        int b = 0; for(uint64_t x = d; x && b < STAT_BUCKETS-1; x >>= 1) b++;
+        calls[p]++; ns[p] += d; hist[p][b]++;
+    }
+    void merge(const ThreadStats &o);
+};
+
+extern bool gStatsTiming;                        // see set_stats_timing
+ThreadStats &stats_local();                      // this thread's counters (registered on first use)
+
+// Times one phase into this thread's stats, if timing is on
+class PhaseTimer {
+    Phase p;
+    std::chrono::steady_clock::time_point t0;
+    bool on;
+public:
+    explicit PhaseTimer(Phase ph) : p(ph), on(gStatsTiming) { if(on) t0 = std::chrono::steady_clock::now(); }
+    ~PhaseTimer(){
+        if(on) stats_local().time(p, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count());
+    }
+};
+
+// lock_guard that counts acquisitions, and contention plus wait time (and a
+// --trace span) when the lock was already held
+class StatLock {
+    std::mutex &m;
+public:
+    explicit StatLock(std::mutex &mtx) : m(mtx) {
+        ThreadStats &st = stats_local();
+        st.add(LOCKS);
+        if(m.try_lock()) return;
+        st.add(LOCKS_CONTENDED);
+        const uint64_t w = trace_mark();
+        { PhaseTimer wait(LOCK_WAIT); m.lock(); }
+        trace_span(TR_LOCK_WAIT, w);
+    }
+    ~StatLock(){ m.unlock(); }
+    StatLock(const StatLock &) = delete;
+    StatLock &operator=(const StatLock &) = delete;
+};
+
+#else
+
+struct ThreadStats {
+    void add(Counter, uint64_t = 1){}
+    void time(Phase, uint64_t){}
+};
+inline ThreadStats &stats_local(){ static ThreadStats none; return none; }
+struct PhaseTimer { explicit PhaseTimer(Phase){} };
+using StatLock = std::lock_guard<std::mutex>;
+
+#endif
+
+// Phase timings are off unless asked for; call before any worker starts
+void set_stats_timing(bool on);
+
+// Text block printed after the summary, and the same numbers as JSON
+void print_stats();
+bool write_stats_json(const std::string &path);
@@ -0,0 +1,190 @@
+#include "sweep.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#include "batch.hpp"
+#include "board.hpp"
+#include "engine.hpp"
+#include "map.hpp"
+#include "results.hpp"
+
+using namespace std;
+
+// Sets the Options field an axis names; false if there is none
+static bool set_axis(Options &o, const string &name, double v){
+    if(name=="rows") o.rows = (int)v;
+    else if(name=="cols") o.cols = (int)v;
+    else if(name=="toons") o.toons = (int)v;
+    else if(name=="shoot-chance") o.sam_shoot_chance = v;
+    else if(name=="jump-chance") o.coy_jump_chance = v;
+    else if(name=="freeze-ms") o.sam_freeze_ms = (int)v;
+    else if(name=="shoot-cooldown") o.sam_cooldown_ms = (int)v;
+    else return false;
+    return true;
+}
+
+// Axes backed by an int field; their values must be whole and fit in an int
+static bool int_axis(const string &name){
+    return name=="rows" || name=="cols" || name=="toons" || name=="freeze-ms" || name=="shoot-cooldown";
+}
+
+vector<SweepAxis> parse_sweep(const string &spec, string &err){
+    vector<SweepAxis> axes;
+    auto fail = [&](const string &why){ err = why; return vector<SweepAxis>(); };
+    for(size_t at = 0; at <= spec.size();){
+        size_t end = min(spec.find(';', at), spec.size());
+        const string part = spec.substr(at, end - at);
+        at = end + 1;
+        if(part.empty()) continue;
+        const size_t eq = part.find('=');
+        SweepAxis ax{part.substr(0, eq), {}};
+        Options probe;
+        if(eq == string::npos || !set_axis(probe, ax.name, 0)) return fail("unknown axis '" + ax.name + "'");
+        for(const SweepAxis &a : axes) if(a.name == ax.name) return fail("axis '" + ax.name + "' given twice");
+        for(size_t v = eq + 1; v <= part.size();){
+            size_t stop = min(part.find(',', v), part.size());
+            const string num = part.substr(v, stop - v);
+            char *tail = nullptr;
+            double x = strtod(num.c_str(), &tail);
+            if(num.empty() || *tail) return fail("bad value '" + num + "' for " + ax.name);
+            if(int_axis(ax.name) && !(x == trunc(x) && x >= INT_MIN && x <= INT_MAX))
+                return fail("bad value '" + num + "' for " + ax.name + ": expected an integer");
+            ax.values.push_back(x);
+            v = stop + 1;
+        }
+        axes.push_back(move(ax));
+    }
+    return axes.empty() ? fail("no axes") : axes;
+}
+
+static string csv_name(int k){
+    string s = TOON_NM[k];
+    for(char &ch : s) ch = (char)tolower((unsigned char)ch);
+    return s;
+}
+
+static void csv_header(){
+    cout << "cell,rows,cols,toons,shoot_chance,jump_chance,freeze_ms,shoot_cooldown,races";
+    for(int k=0;k<NKINDS;k++) cout << "," << csv_name(k) << "_wins";
+    cout << ",no_winner,mean_ticks";
+    for(int k=0;k<NKINDS;k++) cout << "," << csv_name(k) << "_mean_steps";
+    cout << "\n" << flush;
+}
+
+// One finished cell; archetypes the cell has no toons of are left empty
+static string csv_row(int cell, const Options &o, const BatchTally &tot){
+    ostringstream row;
+    const double races = (double)max<uint64_t>(1, tot.races);
+    const int kinds = (int)tot.wins.size();
+    row << cell << "," << o.rows << "," << o.cols << "," << o.toons << "," << o.sam_shoot_chance << ","
+        << o.coy_jump_chance << "," << o.sam_freeze_ms << "," << o.sam_cooldown_ms << "," << tot.races;
+    for(int k=0;k<NKINDS;k++){ row << ","; if(k < kinds) row << tot.wins[k]; }
+    row << "," << tot.noWinner << "," << fixed << setprecision(2) << tot.ticks/races;
+    for(int k=0;k<NKINDS;k++){
+        row << ",";
+        if(k < kinds) row << tot.stepSum[k] / (races*((o.toons - k + NKINDS-1) / NKINDS));
+    }
+    row << "\n";
+    return row.str();
+}
+
+int run_sweep(const Options &opt, const MapFile *map, ResultsFile *results){
+    string err;
+    const vector<SweepAxis> axes = parse_sweep(opt.sweep, err);
+    if(axes.empty()){ cerr << "toons: --sweep: " << err << "\n"; return 1; }
+    for(const SweepAxis &ax : axes)
+        if(map && (ax.name=="rows" || ax.name=="cols" || ax.name=="toons")){
+            cerr << "toons: --sweep: " << ax.name << " is fixed by --map\n"; return 1;
+        }
+    const int races = opt.races > 0 ? opt.races : 100;
+
+    // Every combination, last axis fastest
+    vector<Options> cells(1, opt);
+    for(const SweepAxis &ax : axes){
+        vector<Options> next;
+        next.reserve(cells.size() * ax.values.size());
+        for(const Options &o : cells) for(double v : ax.values){ next.push_back(o); set_axis(next.back(), ax.name, v); }
+        cells.swap(next);
+    }
+    for(Options &o : cells) clamp_options(o);
+
+    // Cells that can share layouts, in order of first appearance
+    vector<vector<int>> groups;
+    for(int c=0;c<(int)cells.size();c++){
+        auto same = [&](const vector<int> &g){
+            const Options &a = cells[g[0]], &b = cells[c];
+            return a.rows == b.rows && a.cols == b.cols && a.toons == b.toons;
+        };
+        auto g = find_if(groups.begin(), groups.end(), same);
+        if(g == groups.end()) groups.push_back({c}); else g->push_back(c);
+    }
+
+    vector<uint64_t> hashes;
+    for(const Options &o : cells) hashes.push_back(options_hash(o));
+    vector<unique_ptr<ResultsBuffer>> rows;         // per worker, across groups
+    for(int w=0;w<opt.jobs;w++) rows.push_back(make_unique<ResultsBuffer>(results));
+
+    csv_header();
+    mutex outMtx;
+    double secs = 0;
+    for(const vector<int> &members : groups){
+        const Options &shape = cells[members[0]];
+        const int M = (int)members.size();
+        const int jobs = min(opt.jobs, M*races);
+
+        vector<Layout> layouts(races);
+        vector<once_flag> built(races);
+        vector<unique_ptr<Board>> boards(jobs);
+        vector<unique_ptr<HeadlessRace>> runs(jobs);
+        vector<Options> ros(jobs, shape);
+        vector<BatchTally> tallies((size_t)jobs*M, BatchTally(shape.toons));   // [worker][member]
+        vector<atomic<int>> left(M);
+        for(auto &l : left) l.store(races, memory_order_relaxed);
+
+        // Items run member-major, so each worker's share finishes whole cells in
+        // turn and rows stream out while later cells still run
+        secs += run_pool(jobs, (uint32_t)(M*races), [&](int w, uint32_t item){
+            const int m = (int)(item / races), i = (int)(item % races);
+            if(!boards[w]) boards[w] = make_unique<Board>(shape.rows, shape.cols, shape.toons);
+            Board &board = *boards[w];
+            Options &ro = ros[w];
+            call_once(built[i], [&]{
+                ro = shape; ro.seed = race_seed(opt.seed, (uint32_t)i);
+                board.reset();
+                if(map) map->load(board, ro); else setup_board(board, ro);
+                layouts[i] = board.layout();
+            });
+            ro = cells[members[m]]; ro.seed = race_seed(opt.seed, (uint32_t)i);
+            board.load(layouts[i]);
+            if(!runs[w]) runs[w] = make_unique<HeadlessRace>(ro, board);
+            else runs[w]->reset();
+            HeadlessRace &race = *runs[w];
+            while(!race.done()) race.tick();
+            tallies[(size_t)w*M + m].add(board, race.result());
+            rows[w]->add(ro.seed, hashes[members[m]], board, race.result());
+
+            // The last race of a cell sees every worker's tally for it (acq_rel)
+            if(left[m].fetch_sub(1, memory_order_acq_rel) == 1){
+                BatchTally tot(shape.toons);
+                for(int k=0;k<jobs;k++) tot.merge(tallies[(size_t)k*M + m]);
+                const string row = csv_row(members[m], cells[members[m]], tot);
+                lock_guard<mutex> lk(outMtx);
+                cout << row << flush;
+            }
+        });
+    }
+    rows.clear();
+    cerr << "sweep: " << cells.size() << " cells x " << races << " races, " << groups.size() << " layout set"
+         << (groups.size() == 1 ? "" : "s") << " of " << races << ", " << fixed << setprecision(2) << secs << " s\n";
+    return 0;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "options.hpp"
+
+// ---- Parameter sweep (--sweep SPEC) ----
+// SPEC is axes separated by ';', each "name=v1,v2,...". Axes: rows, cols, toons,
+// shoot-chance, jump-chance, freeze-ms, shoot-cooldown. Every combination of the
+// values is one cell; the last axis varies fastest.
+
+struct SweepAxis {
+    std::string name;
+    std::vector<double> values;
+};
+
+// Axes in SPEC order; empty with err set if SPEC is malformed
+std::vector<SweepAxis> parse_sweep(const std::string &spec, std::string &err);
+
+class MapFile;
+class ResultsFile;
+
+// Runs opt.races races per cell (100 if unset) on opt.jobs workers and streams one
+// CSV row per cell to stdout as soon as its last race finishes. Race i of every
+// cell uses seed race_seed(opt.seed, i), so cells differ only by their parameters.
+// Cells with the same rows, cols and toons share layouts: layout i is set up once,
+// by whichever worker needs it first, and every cell races on it read-only.
+// results, if given, gets every race, tagged with its cell's options_hash.
+int run_sweep(const Options &opt, const MapFile *map = nullptr, ResultsFile *results = nullptr);
@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "engine.hpp"
+#include "events.hpp"
+#include "render.hpp"
+#include "replay.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+static constexpr size_t BUS_CAP = 1 << 14;
+
+int run_threaded(const Options &opt, Board &board, ReplayWriter *log){
+    atomic<bool> gameOver(false);
+    atomic<int> winner(-1);
+    atomic<int> totalSteps(0);
+
+    rebuild_grid(board);
+    Renderer renderer(board, opt, totalSteps.load());
+
+    // Freezes and cooldowns; advanced by the commit stage (lock) or by whichever
+    // worker holds board.mtx (cas)
+    TimerWheel timers;
+    timers.reserve(2*(size_t)board.n);
+    const auto t0 = steady_clock::now();
+    auto now = [t0]{ return (long long)duration_cast<milliseconds>(steady_clock::now() - t0).count(); };
+
+    // --sync lock: turns publish intents on the bus and the launching thread
+    // commits them (events.hpp). pending[t]: t has intents not yet committed, so
+    // only the commit stage may write its state until it clears the flag.
+    EventBus<BUS_CAP> bus;
+    vector<atomic<uint8_t>> pending(board.n);
+
+    // One turn of toon t, archetype kind, moving by policy steps; false if it is
+    // frozen or its last turn is still in flight
+    auto turn = [&](int t, auto &trng, auto kind, auto steps){
+        constexpr uint8_t K = decltype(kind)::value;
+        using Steps = decltype(steps);
+        if(pending[t].load(memory_order_acquire)) return false;
+        if(board.frozen[t]){ stats_local().add(FROZEN_TURNS); return false; }
+        const uint64_t at = trace_mark();
+        // occ is atomic, so the pick and the look-ahead need no lock; the commit
+        // stage checks every cell again when it applies them
+        Pos step = Steps::step(board, t, flag_dir(board, board.pos(t)), trng);
+        Pos cur = board.pos(t);
+        Pos nxt{cur.r + step.r, cur.c + step.c};
+        const int8_t dr = (int8_t)step.r, dc = (int8_t)step.c;
+
+        Intent out[3];
+        int k = 0;
+        out[k++] = {Intent::STEP, false, dr, dc, t};
+        // Coyote: jump over one cell sometimes when blocked
+        if(K == COYOTE && !can_enter(board,t,nxt) && uniform01(trng) < opt.coy_jump_chance)
+            out[k++] = {Intent::JUMP, false, (int8_t)(2*dr), (int8_t)(2*dc), t};
+        // YosemiteSam: fire & freeze with cooldown
+        if(K == YOSEMITESAM && !board.cooldown[t] && uniform01(trng) < opt.sam_shoot_chance)
+            out[k++] = {Intent::SHOOT, false, 0, 0, t};
+        // RoadRunner: occasional burst (extra step toward flag), rolled every turn;
+        // the commit stage applies it only if the step moved
+        if(K == ROADRUNNER && uniform01(trng) < opt.rr_burst_chance)
+            out[k++] = {Intent::BURST, false, 0, 0, t};
+        out[k-1].last = true;
+        pending[t].store(1, memory_order_relaxed);
+        for(int i=0;i<k;i++){ out[i].at = at; bus.publish(out[i]); }
+        trace_span(TR_TURN, at, t);
+        return true;
+    };
+
+    // Subscribers, in this order, all on the commit thread
+    if(log) bus.subscribe([&](const Committed &c){
+        switch(c.kind){
+        case Committed::MOVE: case Committed::BURST: log->add(c.ms, ReplayRecord::MOVE, c.toon, c.from, c.to); break;
+        case Committed::JUMP: log->add(c.ms, ReplayRecord::JUMP, c.toon, c.from, c.to); break;
+        case Committed::SHOT: if(c.target != -1) log->add(c.ms, ReplayRecord::FREEZE, c.target, (uint32_t)c.toon, (uint32_t)opt.sam_freeze_ms); break;
+        case Committed::THAW: log->add(c.ms, ReplayRecord::THAW, c.toon); break;
+        case Committed::WIN: log->add(c.ms, ReplayRecord::WIN, c.toon); break;
+        default: break;
+        }
+    });
+    bus.subscribe([&](const Committed &c){
+        ThreadStats &st = stats_local();
+        switch(c.kind){
+        case Committed::MOVE: st.add(MOVES); break;
+        case Committed::JUMP: st.add(JUMPS); st.add(MOVES); break;
+        case Committed::BURST: st.add(BURSTS); st.add(MOVES); break;
+        case Committed::BLOCKED: st.add(BLOCKED); break;
+        case Committed::SHOT: st.add(SHOTS); if(c.target != -1) st.add(FROZEN_MS, (uint64_t)opt.sam_freeze_ms); break;
+        default: break;
+        }
+    });
+    bus.subscribe([&](const Committed &c){
+        switch(c.kind){
+        case Committed::MOVE: case Committed::BURST: renderer.frame(++totalSteps, c.decided, c.toon); break;
+        case Committed::JUMP: renderer.frame(++totalSteps, c.decided, c.toon); renderer.jump(c.toon, {(int)(c.to / board.C), (int)(c.to % board.C)}); break;
+        case Committed::SHOT:
+            if(c.target != -1){ renderer.frame(totalSteps.load()); renderer.shot(c.toon, c.target, opt.sam_freeze_ms); }
+            break;
+        default: break;
+        }
+    });
+
+    // The commit stage: applies intents in ring order. A JUMP only applies after a
+    // blocked STEP and a BURST only after one that moved; once the race is over
+    // intents are dropped and only release their toons.
+    vector<uint8_t> moved(board.n, 0), blocked(board.n, 0);
+    mt19937 crng(opt.seed + 777u*(unsigned)(board.n + 1));   // burst tie-breaks: the stream after the toons'
+    auto commit = [&](const Intent &in, auto steps){
+        using Steps = decltype(steps);
+        const int t = in.toon;
+        const long long ms = now();
+        auto go = [&](Committed::Kind k, Pos dest){
+            Pos cur = board.pos(t);
+            if(!can_enter(board,t,dest)) return false;
+            move_toon(board,t,dest);
+            bus.notify({k, t, -1, cell_id(board,cur), cell_id(board,dest), ms, in.at});
+            if(at_goal(board, dest)){ winner.store(t); gameOver.store(true); bus.notify({Committed::WIN, t, -1, 0, 0, ms}); }
+            return true;
+        };
+        if(!gameOver.load()){
+            Pos cur = board.pos(t);
+            if(in.kind == Intent::STEP) trace_latency(L_DECIDE_COMMIT, in.at, trace_now());
+            switch(in.kind){
+            case Intent::STEP: moved[t] = go(Committed::MOVE, {cur.r + in.dr, cur.c + in.dc}); blocked[t] = !moved[t]; break;
+            case Intent::JUMP: if(blocked[t] && go(Committed::JUMP, {cur.r + in.dr, cur.c + in.dc})){ blocked[t] = 0; moved[t] = 1; } break;
+            case Intent::SHOOT:
+                if(!board.cooldown[t]){
+                    int target = nearest_target(board, t);
+                    if(target != -1) freeze_toon(board, timers, target, ms + opt.sam_freeze_ms);
+                    start_cooldown(board, timers, t, ms + opt.sam_cooldown_ms);
+                    bus.notify({Committed::SHOT, t, target, 0, 0, ms});
+                }
+                break;
+            case Intent::BURST:
+                if(moved[t]){ Pos s2 = Steps::burst(board, t, crng); go(Committed::BURST, {cur.r + s2.r, cur.c + s2.c}); }
+                break;
+            }
+        }
+        if(in.last){
+            if(blocked[t] && !gameOver.load()) bus.notify({Committed::BLOCKED, t, -1, 0, 0, ms});
+            moved[t] = blocked[t] = 0;
+            pending[t].store(0, memory_order_release);
+        }
+    };
+    // Thaws and cooldowns due by now, then everything on the bus; false if idle.
+    // board.mtx is only there for the renderer's resync copy of the grid, and is
+    // not taken at all while there is nothing to commit and no timer pending.
+    auto pump = [&](auto steps){
+        if(bus.empty() && !timers.pending()) return false;
+        StatLock lk(board.mtx);
+        const uint64_t c0 = trace_mark();
+        const long long ms = now();
+        timers.advance(ms, [&](const Timer &tm){
+            fire_timer(board, tm);
+            if(tm.kind == Timer::THAW) bus.notify({Committed::THAW, tm.toon, -1, 0, 0, ms});
+        });
+        const size_t k = bus.drain([&](const Intent &in){ commit(in, steps); });
+        if(k) trace_span(TR_COMMIT, c0, (int32_t)k);
+        return k > 0;
+    };
+
+    // --sync cas: the same turn without board.mtx on the move path. Moves claim
+    // cells with a CAS, the first toon to reach the goal wins the CAS on winner,
+    // and the renderer queue takes pushes from any thread. Only timers and
+    // freezes (a few per second) still take board.mtx. shown: glyph on screen
+    // is the frozen one; the owner redraws its toon when that changes. Replay
+    // records go to a per-worker vector (mine), merged by time at the end.
+    const bool cas = opt.sync == Sync::CAS;
+    if(cas) board.render = false;        // no model grid; each worker draws its own toons
+    atomic<long long> timersAt(0);
+    auto turn_cas = [&](int t, auto &trng, uint8_t &shown, vector<ReplayRecord> &mine, auto kind, auto steps){
+        constexpr uint8_t K = decltype(kind)::value;
+        using Steps = decltype(steps);
+        ThreadStats &st = stats_local();
+        auto note = [&](ReplayRecord::Kind k, int toon, uint32_t from = 0, uint32_t to = 0){
+            if(log) mine.push_back(ReplayWriter::record(now(), k, toon, from, to));
+        };
+
+        const uint64_t at = trace_mark();
+        long long ms = now();
+        if(ms > timersAt.load(memory_order_relaxed) && board.mtx.try_lock()){
+            timers.advance(ms, [&](const Timer &tm){
+                fire_timer(board, tm);
+                if(tm.kind == Timer::THAW) note(ReplayRecord::THAW, tm.toon);
+            });
+            timersAt.store(ms, memory_order_relaxed);
+            board.mtx.unlock();
+        }
+        if(board.frozen[t] != shown){ shown = !shown; renderer.cell(board.pos(t), toon_glyph(board,t)); }
+        if(shown){ st.add(FROZEN_TURNS); return false; }
+        TraceScope span(TR_TURN, t);
+
+        auto try_move = [&](Pos dest, ReplayRecord::Kind k){
+            Pos cur = board.pos(t);
+            if((dest.r != cur.r || dest.c != cur.c) && !claim_cell(board,t,dest)) return false;
+            note(k, t, cell_id(board,cur), cell_id(board,dest));
+            board.tr[t] = (int16_t)dest.r; board.tc[t] = (int16_t)dest.c; board.steps[t]++;
+            renderer.move(t, cur, dest, board.at(cur.r,cur.c), toon_glyph(board,t), at);
+            if(dest.r != cur.r || dest.c != cur.c) release_cell(board, cur);
+            st.add(MOVES);
+            return true;
+        };
+        auto win_check = [&]{
+            int none = -1;
+            if(at_goal(board, board.pos(t)) && winner.compare_exchange_strong(none, t)){ gameOver.store(true); note(ReplayRecord::WIN, t); }
+        };
+
+        Pos step = Steps::step(board, t, flag_dir(board, board.pos(t)), trng);
+        Pos cur = board.pos(t);
+        Pos nxt{cur.r + step.r, cur.c + step.c};
+        bool moved=false;
+
+        // Coyote: jump over one cell sometimes when blocked
+        if(K == COYOTE && !can_enter(board,t,nxt) && uniform01(trng) < opt.coy_jump_chance){
+            Pos hop{nxt.r + step.r, nxt.c + step.c};
+            if(try_move(hop, ReplayRecord::JUMP)){ moved = true; st.add(JUMPS); renderer.jump(t, hop); }
+        }
+        if(!moved && !(moved = try_move(nxt, ReplayRecord::MOVE))) st.add(BLOCKED);
+        win_check();
+
+        // YosemiteSam: targets through occ only, so it never reads a position another worker writes
+        if(K == YOSEMITESAM && !gameOver.load() && !board.cooldown[t] && uniform01(trng) < opt.sam_shoot_chance){
+            int target = ring_target(board, board.pos(t));
+            StatLock lk(board.mtx);
+            if(target!=-1){
+                freeze_toon(board, timers, target, now() + opt.sam_freeze_ms);
+                note(ReplayRecord::FREEZE, target, (uint32_t)t, (uint32_t)opt.sam_freeze_ms);
+                renderer.shot(t, target, opt.sam_freeze_ms);
+                st.add(FROZEN_MS, (uint64_t)opt.sam_freeze_ms);
+            }
+            st.add(SHOTS);
+            start_cooldown(board, timers, t, now() + opt.sam_cooldown_ms);
+        }
+
+        // RoadRunner: occasional burst (extra step toward flag)
+        if(K == ROADRUNNER && moved && !gameOver.load() && uniform01(trng) < opt.rr_burst_chance){
+            Pos step2 = Steps::burst(board, t, trng);
+            Pos p2{board.tr[t] + step2.r, board.tc[t] + step2.c};
+            if(can_enter(board,t,p2) && try_move(p2, ReplayRecord::MOVE)){ st.add(BURSTS); win_check(); }
+        }
+        return true;
+    };
+
+    // Worker w owns toons w, w+nThreads, ... and gives each a turn per round. With
+    // the default three toons that is still one thread per toon.
+    const int nThreads = min(board.n, max(NKINDS, opt.jobs));
+    vector<vector<ReplayRecord>> logs(nThreads);
+    auto worker = [&](int w, auto &streams, auto steps){
+        vector<int> mine;
+        vector<typename decay_t<decltype(streams)>::value_type> trng;
+        vector<uint8_t> shown;
+        trace_thread("worker " + to_string(w));
+        for(int t=w;t<board.n;t+=nThreads){ mine.push_back(t); trng.push_back(std::move(streams[t])); shown.push_back(0); }
+
+        // Visual pacing per toon (RoadRunner is fastest)
+        const milliseconds base_sleep(TOON_PERIOD_MS[board.kind[w]]);
+
+        while(!gameOver.load() && !gStop.load()){
+            bool acted = false;
+            for(size_t i=0;i<mine.size() && !gameOver.load();i++)
+                acted |= with_kind(board.kind[mine[i]], [&](auto kind){
+                    return cas ? turn_cas(mine[i], trng[i], shown[i], logs[w], kind, steps) : turn(mine[i], trng[i], kind, steps);
+                });
+            // If frozen, just wait; otherwise global pacing so stacked frames feel smooth
+            PhaseTimer nap(SLEEP);
+            TraceScope span(TR_SLEEP);
+            this_thread::sleep_for(acted ? milliseconds(opt.delay_ms) : base_sleep);
+        }
+    };
+
+    // The launching thread is the commit stage (lock) or only waits (cas). Idle,
+    // the commit stage sleeps on the bus until a turn publishes or a millisecond
+    // of timers is due. A worker may be stuck publishing to a full bus when the
+    // race ends, so the bus is drained until every worker is out.
+    atomic<int> live(nThreads);
+    if(!cas) trace_thread("commit");
+    auto launch = [&](auto streams){
+        vector<thread> workers; workers.reserve(nThreads);
+        with_policy(opt.policy, [&](auto steps){
+            for(int w=0;w<nThreads;w++) workers.emplace_back([&, w, steps]{ worker(w, streams, steps); live.fetch_sub(1); });
+            if(cas) while(!gameOver.load() && !gStop.load()) this_thread::sleep_for(milliseconds(5));
+            else {
+                while(!gameOver.load() && !gStop.load()) if(!pump(steps)) bus.wait_for(milliseconds(1));
+                while(live.load()) if(!pump(steps)) bus.wait_for(milliseconds(1));
+            }
+        });
+        for(auto &th : workers) th.join();
+    };
+    if(opt.rng == RngKind::XOSHIRO) launch(toon_streams<FastRng>(opt.seed, board.n));
+    else launch(toon_streams<mt19937>(opt.seed, board.n));
+
+    if(log && cas){
+        vector<ReplayRecord> all;
+        for(auto &l : logs) all.insert(all.end(), l.begin(), l.end());
+        stable_sort(all.begin(), all.end(), [](const ReplayRecord &a, const ReplayRecord &b){ return a.tick < b.tick; });
+        log->append(all);
+    }
+
+    // Final board (the renderer's view already holds every patch)
+    int steps = totalSteps.load();
+    if(cas){ steps = 0; for(int t=0;t<board.n;t++) steps += (int)board.steps[t]; }
+    renderer.finish(steps);
+    print_summary(board, winner.load());
+    return 0;
+}
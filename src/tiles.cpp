@@ -0,0 +1,57 @@
+#include "tiles.hpp"
+
+using namespace std;
+
+void TileMap::build(const Board &b){
+    tilesR = (b.R + TILE - 1) / TILE; tilesC = (b.C + TILE - 1) / TILE;
+    const size_t tiles = (size_t)tilesR * tilesC;
+    first.assign(tiles + 1, 0);
+    for(int t=0;t<b.n;t++) first[tile_of(b.tr[t], b.tc[t]) + 1]++;
+    for(size_t k=0;k<tiles;k++) first[k+1] += first[k];
+    toons.resize(b.n);
+    cursor.assign(first.begin(), first.end() - 1);
+    for(int t=0;t<b.n;t++) toons[cursor[tile_of(b.tr[t], b.tc[t])]++] = t;
+    for(auto &v : busy) v.clear();
+    for(size_t k=0;k<tiles;k++)
+        if(first[k+1] > first[k]) busy[colour((int)(k / tilesC), (int)(k % tilesC))].push_back((uint32_t)k);
+}
+
+LanePool::LanePool(int lanes){
+    helpers.reserve(lanes - 1);
+    for(int w=1;w<lanes;w++) helpers.emplace_back(&LanePool::helper, this, w);
+}
+
+LanePool::~LanePool(){
+    { lock_guard<mutex> lk(mtx); quit = true; }
+    go.notify_all();
+    for(auto &th : helpers) th.join();
+}
+
+void LanePool::helper(int lane){
+    uint64_t seen = 0;
+    for(;;){
+        {
+            unique_lock<mutex> lk(mtx);
+            go.wait(lk, [&]{ return gen != seen || quit; });
+            if(quit) return;
+            seen = gen;
+        }
+        drain(lane);
+        lock_guard<mutex> lk(mtx);
+        if(--running == 0) idle.notify_one();
+    }
+}
+
+void LanePool::dispatch(void (*f)(void *, int, uint32_t), void *c, uint32_t k){
+    {
+        lock_guard<mutex> lk(mtx);
+        fn = f; ctx = c; count = k;
+        next.store(0, memory_order_relaxed);
+        running = (int)helpers.size();
+        gen++;
+    }
+    go.notify_all();
+    drain(0);
+    unique_lock<mutex> lk(mtx);
+    idle.wait(lk, [&]{ return running == 0; });
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "board.hpp"
+
+// ---- Tiles (--sched tiles) ----
+// The board is cut into TILE x TILE blocks (64x64 cells: 4 KB of cells plus
+// 16 KB each of occ and dist, so one block's working set stays in L2) and the
+// toons are bucketed per block. A tick runs the blocks in four colours by
+// (tile row, tile column) parity: blocks of one colour have a whole block
+// between them, and a turn reads and writes nothing further than two cells
+// from its toon (jump, or move plus burst), so every block of a colour can run
+// at once without touching another's cells. Moves may leave their block; the
+// toon is bucketed afresh at the next tick.
+
+static constexpr int TILE = 64;
+
+struct TileMap {
+    int tilesR = 0, tilesC = 0;
+    std::vector<uint32_t> first;                 // toons of tile k: toons[first[k] .. first[k+1])
+    std::vector<int32_t> toons;                  // by tile, in index order within each
+    std::array<std::vector<uint32_t>, 4> busy;   // per colour, tiles holding any toon
+    std::vector<uint32_t> cursor;                // build() scratch
+
+    int tile_of(int r, int c) const { return (r / TILE) * tilesC + c / TILE; }
+    static int colour(int tr, int tc){ return (tr & 1) * 2 + (tc & 1); }
+    // Counting sort of the toons by tile, O(toons + tiles); buffers are reused
+    void build(const Board &b);
+};
+
+// What a tile's turns leave for the race to merge after the colour
+struct alignas(64) Lane {
+    int steps = 0, jumps = 0, bursts = 0;
+    int winner = -1;                             // lowest toon that reached the goal
+    std::vector<int> shots;                      // YosemiteSams that fired, resolved after the tick
+};
+
+// Helper threads for one race: run(k, f) calls f(lane, i) for every i < k on
+// the caller (lane 0) and lanes-1 helpers, and returns once all are done.
+// Helpers sleep on a condition variable between runs; nothing allocates.
+class LanePool {
+    std::vector<std::thread> helpers;
+    std::mutex mtx;
+    std::condition_variable go, idle;
+    uint64_t gen = 0;
+    int running = 0;
+    bool quit = false;
+    void (*fn)(void *, int, uint32_t) = nullptr;
+    void *ctx = nullptr;
+    uint32_t count = 0;
+    std::atomic<uint32_t> next{0};
+
+    void drain(int lane){
+        for(uint32_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;) fn(ctx, lane, i);
+    }
+    void helper(int lane);
+    void dispatch(void (*f)(void *, int, uint32_t), void *c, uint32_t k);
+public:
+    explicit LanePool(int lanes);
+    ~LanePool();
+    LanePool(const LanePool &) = delete;
+    LanePool &operator=(const LanePool &) = delete;
+    int lanes() const { return (int)helpers.size() + 1; }
+
+    template<class F> void run(uint32_t k, F &f){
+        dispatch([](void *c, int lane, uint32_t i){ (*static_cast<F*>(c))(lane, i); }, &f, k);
+    }
+};
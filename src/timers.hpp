@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "board.hpp"
+
+// Hashed timer wheel on the race clock (ms): a timer sits in slot when % SLOTS
+// and fires on the first advance() past its deadline. Deadlines further out
+// than one revolution simply stay put until their turn. The same wheel runs on
+// wall-clock ms in the threaded mode and on simulated ms in headless mode.
+// Timers are nodes in one pool, linked per slot and recycled through a free
+// list, so once reserve()d for the most timers that can be pending (two per
+// toon: a thaw and a cooldown) scheduling never allocates.
+
+struct Timer {
+    enum Kind : uint8_t { THAW, READY } kind;   // end of a freeze / of an ability cooldown
+    int toon;
+    long long when;
+};
+
+class TimerWheel {
+    static constexpr int SLOTS = 512;
+    struct Node { Timer tm; int32_t next; };
+    std::vector<Node> pool;
+    std::array<int32_t, SLOTS> head;     // first node of each slot, -1 = empty
+    int32_t free_ = -1;                  // recycled nodes, linked through next
+    long long now_ = 0;                  // everything due at or before now_ has fired
+    size_t pending_ = 0;
+public:
+    TimerWheel(){ head.fill(-1); }
+    void reserve(size_t n){ pool.reserve(n); }
+    size_t pending() const { return pending_; }
+
+    // Drop every timer and restart the clock at now (a new race, or a snapshot)
+    void reset(long long now){
+        head.fill(-1); pool.clear(); free_ = -1;
+        now_ = now; pending_ = 0;
+    }
+
+    void schedule(Timer tm){
+        tm.when = std::max(tm.when, now_+1);
+        int32_t k = free_;
+        if(k >= 0){ free_ = pool[k].next; pool[k].tm = tm; }
+        else { k = (int32_t)pool.size(); pool.push_back({tm, -1}); }
+        int32_t &h = head[tm.when & (SLOTS-1)];
+        pool[k].next = h; h = k;
+        pending_++;
+    }
+
+    // Fires every timer due by now; fire() must not schedule
+    template<class Fire> void advance(long long now, Fire &&fire){
+        if(now <= now_) return;
+        long long span = pending_ ? std::min<long long>(now - now_, SLOTS) : 0;
+        for(long long k=1;k<=span;k++){
+            const int s = (int)((now_ + k) & (SLOTS-1));
+            for(int32_t prev = -1, i = head[s]; i >= 0;){
+                if(pool[i].tm.when > now){ prev = i; i = pool[i].next; continue; }
+                const Timer tm = pool[i].tm;
+                const int32_t next = pool[i].next;
+                (prev < 0 ? head[s] : pool[prev].next) = next;
+                pool[i].next = free_; free_ = i; pending_--;
+                fire(tm);
+                i = next;
+            }
+        }
+        now_ = now;
+    }
+};
+
+// Default effect of a due timer; callers wrap it when they need to react too
+inline void fire_timer(Board &b, const Timer &tm){
+    if(tm.kind == Timer::THAW) set_frozen(b, tm.toon, false);
+    else b.cooldown[tm.toon] = 0;
+}
+
+inline void freeze_toon(Board &b, TimerWheel &timers, int target, long long until){
+    b.frozen_until[target] = (uint32_t)until;
+    set_frozen(b, target, true);
+    timers.schedule({Timer::THAW, target, until});
+}
+
+inline void start_cooldown(Board &b, TimerWheel &timers, int t, long long until){
+    b.cooldown_until[t] = (uint32_t)until;
+    b.cooldown[t] = 1;
+    timers.schedule({Timer::READY, t, until});
+}
@@ -0,0 +1,146 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+using namespace std;
+using namespace std::chrono;
+
+static const char *TRACE_NM[NTRACENAMES] = {"turn", "sleep", "lock wait", "commit", "frame", "write", "event pause", "resync", "move"};
+static const char *TRACE_ARG[NTRACENAMES] = {"toon", nullptr, nullptr, "intents", "frame", "bytes", nullptr, nullptr, "toon"};
+static const char *LATENCY_NM[NLATENCIES] = {"decide_to_commit", "commit_to_frame", "decide_to_frame", "stdout_write"};
+
+bool gTracing = false;
+steady_clock::time_point gTraceT0 = steady_clock::now();
+
+void set_tracing(bool on){ gTracing = on; gTraceT0 = steady_clock::now(); }
+
+static mutex gTraceMtx;
+static vector<unique_ptr<TraceBuf>> gTraceAll;    // one per thread that ever traced
+
+TraceBuf &trace_local(){
+    thread_local TraceBuf *mine = nullptr;
+    if(!mine){
+        lock_guard<mutex> lk(gTraceMtx);
+        gTraceAll.push_back(make_unique<TraceBuf>());
+        mine = gTraceAll.back().get();
+        mine->thread = "thread " + to_string(gTraceAll.size() - 1);
+    }
+    return *mine;
+}
+
+void trace_thread(const string &name){ if(gTracing) trace_local().thread = name; }
+
+void HdrHist::merge(const HdrHist &o){
+    for(size_t i=0;i<n.size();i++) n[i] += o.n[i];
+    count += o.count; sum += o.sum;
+    min = std::min(min, o.min); max = std::max(max, o.max);
+}
+
+uint64_t HdrHist::pct(double q) const {
+    if(!count) return 0;
+    const uint64_t want = std::max<uint64_t>(1, (uint64_t)(q * (double)count + 0.5));
+    uint64_t seen = 0;
+    for(size_t i=0;i<n.size();i++) if((seen += n[i]) >= want) return std::min(upper(i), max);
+    return max;
+}
+
+// Call once the threads that traced are done
+static void latency_total(HdrHist (&tot)[NLATENCIES]){
+    lock_guard<mutex> lk(gTraceMtx);
+    for(auto &b : gTraceAll) for(int l=0;l<NLATENCIES;l++) tot[l].merge(b->hist[l]);
+}
+
+static const double PCTS[] = {0.5, 0.9, 0.99, 0.999};
+static const char *PCT_NM[] = {"p50", "p90", "p99", "p99.9"};
+
+void print_latency(){
+    HdrHist tot[NLATENCIES];
+    latency_total(tot);
+    cout << "=== Latency ===\n" << fixed << setprecision(1);
+    for(int l=0;l<NLATENCIES;l++){
+        const HdrHist &h = tot[l];
+        if(!h.count) continue;
+        cout << LATENCY_NM[l] << ": " << h.count << " x, mean " << h.sum/1e3/h.count << " us";
+        for(int p=0;p<4;p++) cout << ", " << PCT_NM[p] << " <= " << h.pct(PCTS[p])/1e3 << " us";
+        cout << ", max " << h.max/1e3 << " us\n";
+    }
+    if(!tot[L_DECIDE_FRAME].count) cout << "(move latencies come from threaded races)\n";
+}
+
+// Microseconds with ns precision, as the trace format wants them
+static void put_us(FILE *f, uint64_t ns){ fprintf(f, "%llu.%03u", (unsigned long long)(ns / 1000), (unsigned)(ns % 1000)); }
+
+bool write_trace(const string &path){
+    HdrHist tot[NLATENCIES];
+    latency_total(tot);
+    FILE *f = fopen(path.c_str(), "w");
+    if(!f) return false;
+    lock_guard<mutex> lk(gTraceMtx);
+    fputs("{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n", f);
+    bool first = true;
+    auto open = [&](const char *name, const char *ph, size_t tid, uint64_t ts){
+        fprintf(f, "%s{\"name\": \"%s\", \"ph\": \"%s\", \"pid\": 1, \"tid\": %zu, \"ts\": ", first ? "" : ",\n", name, ph, tid);
+        put_us(f, ts);
+        first = false;
+    };
+    uint64_t dropped = 0, moveId = 0;
+    for(size_t tid=0;tid<gTraceAll.size();tid++){
+        const TraceBuf &b = *gTraceAll[tid];
+        fprintf(f, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %zu, \"args\": {\"name\": \"%s\"}}", first ? "" : ",\n", tid, b.thread.c_str());
+        first = false;
+        const uint64_t kept = std::min<uint64_t>(b.added, TRACE_RING);
+        dropped += b.added - kept;
+        for(uint64_t k=b.added-kept;k<b.added;k++){
+            const TraceEvent &e = b.ev[k & (TRACE_RING - 1)];
+            const char *arg = TRACE_ARG[e.name];
+            if(e.name == TR_MOVE){
+                // A nestable async slice per move, split where it was committed
+                const uint64_t id = ++moveId;
+                const uint64_t at[4] = {e.ts, e.ts, e.mid, e.mid};
+                const char *part[4] = {"move", "to commit", "to commit", "to frame"};
+                const char *ph[4] = {"b", "b", "e", "b"};
+                for(int i=0;i<4;i++){
+                    open(part[i], ph[i], tid, at[i]);
+                    fprintf(f, ", \"cat\": \"move\", \"id\": %llu", (unsigned long long)id);
+                    if(i == 0) fprintf(f, ", \"args\": {\"toon\": %d}", e.arg);
+                    fputs("}", f);
+                }
+                for(const char *p : {"to frame", "move"}){
+                    open(p, "e", tid, e.end);
+                    fprintf(f, ", \"cat\": \"move\", \"id\": %llu}", (unsigned long long)id);
+                }
+                continue;
+            }
+            if(e.end > e.ts){ open(TRACE_NM[e.name], "X", tid, e.ts); fputs(", \"dur\": ", f); put_us(f, e.end - e.ts); }
+            else { open(TRACE_NM[e.name], "i", tid, e.ts); fputs(", \"s\": \"t\"", f); }
+            if(arg) fprintf(f, ", \"args\": {\"%s\": %d}", arg, e.arg);
+            fputs("}", f);
+        }
+    }
+    fputs("\n],\n", f);
+
+    // The histograms: nonzero buckets as [highest ns, count]
+    fprintf(f, "\"toonsDroppedEvents\": %llu,\n\"toonsLatency\": {\n", (unsigned long long)dropped);
+    for(int l=0;l<NLATENCIES;l++){
+        const HdrHist &h = tot[l];
+        fprintf(f, "  \"%s\": {\"count\": %llu, \"sum_ns\": %llu, \"min_ns\": %llu, \"max_ns\": %llu", LATENCY_NM[l],
+                (unsigned long long)h.count, (unsigned long long)h.sum, (unsigned long long)(h.count ? h.min : 0), (unsigned long long)h.max);
+        for(int p=0;p<4;p++) fprintf(f, ", \"%s_ns\": %llu", PCT_NM[p], (unsigned long long)h.pct(PCTS[p]));
+        fputs(", \"buckets\": [", f);
+        bool any = false;
+        for(size_t i=0;i<h.buckets().size();i++){
+            if(!h.buckets()[i]) continue;
+            fprintf(f, "%s[%llu, %llu]", any ? ", " : "", (unsigned long long)HdrHist::upper(i), (unsigned long long)h.buckets()[i]);
+            any = true;
+        }
+        fprintf(f, "]}%s\n", l+1<NLATENCIES ? "," : "");
+    }
+    fputs("}}\n", f);
+    const bool ok = !ferror(f);
+    return fclose(f) == 0 && ok;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bitboard.hpp"
+
+// ---- Move tracing (--trace FILE) ----
+// Every thread records spans into its own fixed ring of TRACE_RING events (the
+// oldest are overwritten), so a trace point is a clock read and a store on a
+// private buffer; with tracing off it is one test of gTracing. In a threaded
+// race a move is followed from the worker's decision through the commit stage
+// to the frame that shows it: the intent carries its decision time, the
+// renderer message its commit time, and the renderer closes the move once that
+// frame is written. Those latencies, and every stdout write, also go into
+// log-linear (HDR) histograms. At exit the rings are written as Chrome trace
+// JSON (chrome://tracing, ui.perfetto.dev) with the histograms alongside.
+
+enum TraceName : uint8_t { TR_TURN, TR_SLEEP, TR_LOCK_WAIT, TR_COMMIT, TR_FRAME, TR_WRITE, TR_PAUSE, TR_RESYNC, TR_MOVE, NTRACENAMES };
+enum Latency : uint8_t { L_DECIDE_COMMIT, L_COMMIT_FRAME, L_DECIDE_FRAME, L_WRITE, NLATENCIES };
+
+constexpr size_t TRACE_RING = 1 << 16;           // events kept per thread
+
+// ns since the trace began; end == ts for an instant. A MOVE runs from its
+// decision (ts) through its commit (mid) to the frame (end).
+struct TraceEvent {
+    uint64_t ts, end, mid;
+    int32_t arg;                                 // the toon, or a count
+    uint8_t name;
+};
+
+// Values in ns with 32 sub-buckets per power of two (about 3% wide), exact below 64
+class HdrHist {
+    static constexpr int SUB = 32, MAXSHIFT = 40;
+    std::vector<uint64_t> n = std::vector<uint64_t>((MAXSHIFT + 2) * SUB, 0);
+public:
+    uint64_t count = 0, sum = 0, min = UINT64_MAX, max = 0;
+    static size_t index(uint64_t v){
+        if(v < 2*SUB) return (size_t)v;
+        int shift = 63 - clz64(v) - 5;
+        if(shift > MAXSHIFT){ shift = MAXSHIFT; v = (2ull*SUB << shift) - 1; }
+        return (size_t)shift*SUB + (size_t)(v >> shift);
+    }
+    static uint64_t upper(size_t i){                 // highest value of bucket i
+        if(i < 2*SUB) return i;
+        const int shift = (int)(i / SUB) - 1;
+        return ((uint64_t)(i - (size_t)shift*SUB + 1) << shift) - 1;
+    }
+    void add(uint64_t v){ n[index(v)]++; count++; sum += v; if(v < min) min = v; if(v > max) max = v; }
+    void merge(const HdrHist &o);
+    uint64_t pct(double q) const;                    // bucket upper bound, capped at max
+    const std::vector<uint64_t> &buckets() const { return n; }
+};
+
+struct TraceBuf {
+    std::string thread;                          // track name in the trace
+    std::vector<TraceEvent> ev;
+    uint64_t added = 0;
+    HdrHist hist[NLATENCIES];
+
+    TraceBuf() : ev(TRACE_RING) {}
+    void add(const TraceEvent &e){ ev[added++ & (TRACE_RING - 1)] = e; }
+};
+
+extern bool gTracing;                            // see set_tracing
+extern std::chrono::steady_clock::time_point gTraceT0;
+TraceBuf &trace_local();                         // this thread's ring (registered on first use)
+
+inline uint64_t trace_now(){
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - gTraceT0).count();
+}
+inline uint64_t trace_mark(){ return gTracing ? trace_now() : 0; }
+
+// Names this thread's track; no-op unless tracing
+void trace_thread(const std::string &name);
+
+inline void trace_span(TraceName nm, uint64_t ts, int32_t arg = 0){
+    if(gTracing) trace_local().add({ts, trace_now(), 0, arg, nm});
+}
+inline void trace_latency(Latency l, uint64_t from, uint64_t to){
+    if(gTracing && from) trace_local().hist[l].add(to > from ? to - from : 0);
+}
+
+// Records one span from construction to destruction, if tracing
+class TraceScope {
+    TraceName nm;
+    int32_t arg;
+    bool on;
+    uint64_t ts = 0;
+public:
+    explicit TraceScope(TraceName n, int32_t a = 0) : nm(n), arg(a), on(gTracing) { if(on) ts = trace_now(); }
+    ~TraceScope(){ if(on) trace_local().add({ts, trace_now(), 0, arg, nm}); }
+    void set_arg(int32_t a){ arg = a; }
+};
+
+// Tracing is off unless asked for; call before any worker starts
+void set_tracing(bool on);
+
+// Latency percentiles printed after the summary, and the Chrome trace JSON
+void print_latency();
+bool write_trace(const std::string &path);
@@ -0,0 +1,43 @@
+# A 200x400 map fits far more toons than the default 18x36 board; --toons is
+# checked against the map, not the board size given before --map is read.
+# Usage: cmake -DTOONS=<path to toons> -DWORK=<scratch dir> -P map_toons.cmake
+string(REPEAT "." 399 row)
+string(REPEAT "${row}|\n" 200 cells)
+set(map "${WORK}/big.map")
+file(WRITE "${map}" "${cells}")
+
+execute_process(COMMAND "${TOONS}" --map "${map}" --toons 1000 --headless --seed 1 --frames final
+                RESULT_VARIABLE rc OUTPUT_VARIABLE out)
+if(NOT rc EQUAL 0)
+  message(FATAL_ERROR "toons --map failed (${rc}):\n${out}")
+endif()
+foreach(kind "RoadRunner \\(R\\) x334" "Coyote \\(C\\) x333" "YosemiteSam \\(Y\\) x333")
+  if(NOT out MATCHES "${kind}")
+    message(FATAL_ERROR "expected '${kind}' in:\n${out}")
+  endif()
+endforeach()
+
+# The same race as a --serve spec
+string(REGEX MATCH "Winner: ([^\n]+)" _ "${out}")
+set(winner "${CMAKE_MATCH_1}")
+execute_process(COMMAND "${CMAKE_COMMAND}" -E echo "a map=${map} toons=1000 seed=1"
+                COMMAND "${TOONS}" --serve - --jobs 1
+                OUTPUT_VARIABLE out ERROR_QUIET)
+if(NOT out MATCHES "^a ${winner} ")
+  message(FATAL_ERROR "--serve did not run the 1000-toon race won by ${winner}: ${out}")
+endif()
+
+execute_process(COMMAND "${TOONS}" --map "${map}" --toons 100000 --headless --seed 1
+                RESULT_VARIABLE rc OUTPUT_VARIABLE out ERROR_VARIABLE err)
+if(rc EQUAL 0 OR NOT err MATCHES "not enough open cells")
+  message(FATAL_ERROR "too many toons for the map were not rejected (${rc}): ${err}")
+endif()
+
+# Map starts obey the same column limit as drawn ones: left of the goal column
+set(map "${WORK}/late.map")
+file(WRITE "${map}" ".......|S\n.......|.\n.......|.\n")
+execute_process(COMMAND "${TOONS}" --map "${map}" --toons 1 --headless --seed 1
+                RESULT_VARIABLE rc OUTPUT_VARIABLE out ERROR_VARIABLE err)
+if(rc EQUAL 0 OR NOT err MATCHES "start on or past the finish line")
+  message(FATAL_ERROR "a start past the finish line was not rejected (${rc}): ${out}${err}")
+endif()
@@ -0,0 +1,18 @@
+# A --sched tiles race stamps its replay records with ticks whether it plays
+# headless or through the view, so --frame reads both logs in ticks.
+# Usage: cmake -DTOONS=<path to toons> -DWORK=<scratch dir> -P replay_tiles.cmake
+foreach(mode view headless)
+  set(log "${WORK}/tiles_${mode}.rep")
+  set(args --sched tiles --seed 1 --delay 1 --frames final --record "${log}")
+  if(mode STREQUAL "headless")
+    list(APPEND args --headless)
+  endif()
+  execute_process(COMMAND "${TOONS}" ${args} RESULT_VARIABLE rc OUTPUT_VARIABLE out ERROR_VARIABLE err)
+  if(NOT rc EQUAL 0)
+    message(FATAL_ERROR "toons --sched tiles --record (${mode}) failed (${rc}):\n${out}${err}")
+  endif()
+  execute_process(COMMAND "${TOONS}" --replay "${log}" --frame 5 RESULT_VARIABLE rc OUTPUT_VARIABLE out ERROR_VARIABLE err)
+  if(NOT rc EQUAL 0 OR NOT out MATCHES "Replay: tick 5,")
+    message(FATAL_ERROR "replay of the ${mode} tiles race is not in ticks (${rc}):\n${out}${err}")
+  endif()
+endforeach()